@@ -6,21 +6,25 @@
 #define SEARCH_SERVER_CONCURRENT_MAP_H
 
 #include <algorithm>
-#include <future>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
 #include <vector>
+#include "task_scheduler.h"
 
-template<typename Key, typename Value>
+// Ключи распределяются по независимым корзинам с помощью Hash, у каждой корзины своя блокировка.
+// Корзины выровнены по кэш-линии, чтобы потоки, работающие с соседними корзинами, не мешали друг другу.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
 class ConcurrentMap {
 private:
-    struct Bucket {
+    struct alignas(64) Bucket {
         std::mutex mutex;
-        std::map<Key, Value> map;
+        std::unordered_map<Key, Value, Hash> map;
     };
 
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
-
     struct Access {
         std::lock_guard<std::mutex> guard;
         Value &ref_to_value;
@@ -30,32 +34,122 @@ public:
         }
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-            : buckets_(bucket_count) {
+    // Локальная для потока часть словаря: прибавления копятся без блокировок и переносятся
+    // в общий словарь в Flush (или в деструкторе), при этом каждая корзина блокируется один раз
+    class LocalShard {
+    public:
+        explicit LocalShard(ConcurrentMap &target) : target_(target) {}
+
+        LocalShard(const LocalShard &) = delete;
+
+        LocalShard &operator=(const LocalShard &) = delete;
+
+        ~LocalShard() {
+            Flush();
+        }
+
+        void FetchAdd(const Key &key, const Value &delta) {
+            pending_[key] += delta;
+        }
+
+        void Flush() {
+            std::vector<std::vector<const std::pair<const Key, Value> *>> by_bucket(target_.buckets_.size());
+            for (const auto &entry: pending_) {
+                by_bucket[target_.GetBucketIndex(entry.first)].push_back(&entry);
+            }
+            for (size_t i = 0; i < by_bucket.size(); ++i) {
+                if (by_bucket[i].empty()) {
+                    continue;
+                }
+                auto &bucket = target_.buckets_[i];
+                std::lock_guard lock(bucket.mutex);
+                for (const auto *entry: by_bucket[i]) {
+                    bucket.map[entry->first] += entry->second;
+                }
+            }
+            pending_.clear();
+        }
+
+    private:
+        ConcurrentMap &target_;
+        std::unordered_map<Key, Value, Hash> pending_;
+    };
+
+    explicit ConcurrentMap(size_t bucket_count, const Hash &hash = Hash())
+            : buckets_(bucket_count), hash_(hash) {
     }
 
     Access operator[](const Key &key) {
-        auto &bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return {key, bucket};
+        return {key, GetBucket(key)};
     }
 
-    void erase(const Key &key){
-        auto &bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+    // Прибавляет delta к значению по ключу и возвращает предыдущее значение
+    Value FetchAdd(const Key &key, const Value &delta) {
+        auto &bucket = GetBucket(key);
+        std::lock_guard lock(bucket.mutex);
+        Value &value = bucket.map[key];
+        Value previous = value;
+        value += delta;
+        return previous;
+    }
+
+    void erase(const Key &key) {
+        auto &bucket = GetBucket(key);
         std::lock_guard lock(bucket.mutex);
         bucket.map.erase(key);
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
+    // Корзины обрабатываются параллельно на task_scheduler, а затем отсортированные корзины
+    // сливаются в один словарь
+    std::map<Key, Value> BuildOrdinaryMap(TaskScheduler &task_scheduler = TaskScheduler::GetDefault()) {
+        using Entry = std::pair<Key, Value>;
+        std::vector<std::vector<Entry>> sorted_buckets(buckets_.size());
+        task_scheduler.ParallelFor(buckets_.size(), [&](size_t i) {
+            Bucket &bucket = buckets_[i];
+            std::vector<Entry> &entries = sorted_buckets[i];
+            {
+                std::lock_guard lock(bucket.mutex);
+                entries.assign(bucket.map.begin(), bucket.map.end());
+            }
+            std::sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+                return lhs.first < rhs.first;
+            });
+        });
+
+        // Элементы приходят по возрастанию ключа, поэтому вставка с подсказкой end() стоит O(1)
+        using Cursor = std::pair<typename std::vector<Entry>::const_iterator, size_t>;
+        auto greater = [](const Cursor &lhs, const Cursor &rhs) {
+            return rhs.first->first < lhs.first->first;
+        };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heads(greater);
+        for (size_t i = 0; i < sorted_buckets.size(); ++i) {
+            if (!sorted_buckets[i].empty()) {
+                heads.push({sorted_buckets[i].begin(), i});
+            }
+        }
         std::map<Key, Value> result;
-        for (auto &[mutex, map]: buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+        while (!heads.empty()) {
+            auto [it, bucket_index] = heads.top();
+            heads.pop();
+            result.emplace_hint(result.end(), *it);
+            if (++it != sorted_buckets[bucket_index].end()) {
+                heads.push({it, bucket_index});
+            }
         }
         return result;
     }
 
 private:
     std::vector<Bucket> buckets_;
+    Hash hash_;
+
+    size_t GetBucketIndex(const Key &key) const {
+        return hash_(key) % buckets_.size();
+    }
+
+    Bucket &GetBucket(const Key &key) {
+        return buckets_[GetBucketIndex(key)];
+    }
 };
 
 #endif //SEARCH_SERVER_CONCURRENT_MAP_H
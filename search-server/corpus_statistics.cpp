@@ -0,0 +1,44 @@
+//
+// -------- Статистика корпуса ----------
+//
+
+#include "corpus_statistics.h"
+
+using namespace std;
+
+CorpusStatistics::CorpusStatistics(int document_count, const vector<pair<string_view, size_t>> &document_freqs)
+        : document_count_(document_count) {
+    for (const auto &[word, document_freq]: document_freqs) {
+        const TermId term_id = terms_.Intern(word);
+        if (term_id >= document_freqs_.size()) {
+            document_freqs_.resize(term_id + 1, 0);
+        }
+        document_freqs_[term_id] = document_freq;
+    }
+}
+
+void CorpusStatistics::AddDocument(const map<string_view, double> &word_frequencies) {
+    ++document_count_;
+    for (const auto &[word, term_freq]: word_frequencies) {
+        const TermId term_id = terms_.Intern(word);
+        if (term_id >= document_freqs_.size()) {
+            document_freqs_.resize(term_id + 1, 0);
+        }
+        ++document_freqs_[term_id];
+    }
+}
+
+void CorpusStatistics::RemoveDocument(const map<string_view, double> &word_frequencies) {
+    --document_count_;
+    for (const auto &[word, term_freq]: word_frequencies) {
+        const TermId term_id = terms_.Find(word);
+        if (--document_freqs_[term_id] == 0) {
+            terms_.Erase(term_id);
+        }
+    }
+}
+
+size_t CorpusStatistics::GetDocumentFrequency(string_view word) const {
+    const TermId term_id = terms_.Find(word);
+    return term_id == INVALID_TERM_ID ? 0 : document_freqs_[term_id];
+}
@@ -0,0 +1,41 @@
+//
+// -------- Статистика корпуса ----------
+//
+
+#ifndef SEARCH_SERVER_CORPUS_STATISTICS_H
+#define SEARCH_SERVER_CORPUS_STATISTICS_H
+
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "term_dictionary.h"
+
+// Число документов и документная частота слов по всему корпусу. Нужна, когда корпус разбит
+// на несколько серверов: IDF каждого сервера должен считаться по корпусу целиком,
+// иначе релевантности документов из разных серверов несравнимы.
+class CorpusStatistics {
+public:
+    CorpusStatistics() = default;
+
+    // Статистика, собранная вне сервера, например со всех шардов (см. ShardedSearchServer)
+    CorpusStatistics(int document_count, const std::vector<std::pair<std::string_view, size_t>> &document_freqs);
+
+    // word_frequencies - частоты слов документа, как их возвращает SearchServer::GetWordFrequencies
+    void AddDocument(const std::map<std::string_view, double> &word_frequencies);
+
+    void RemoveDocument(const std::map<std::string_view, double> &word_frequencies);
+
+    [[nodiscard]] int GetDocumentCount() const { return document_count_; }
+
+    // Число документов, содержащих слово
+    [[nodiscard]] size_t GetDocumentFrequency(std::string_view word) const;
+
+private:
+    int document_count_ = 0;
+    TermDictionary terms_;
+    // Индекс в векторе - TermId в terms_
+    std::vector<size_t> document_freqs_;
+};
+
+#endif //SEARCH_SERVER_CORPUS_STATISTICS_H
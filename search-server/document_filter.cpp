@@ -0,0 +1,88 @@
+//
+// -------- Фильтры документов ----------
+//
+
+#include "document_filter.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+void DocumentBitmap::Set(const Posting *first, const Posting *last) {
+    size_t pending_word = numeric_limits<size_t>::max();
+    uint64_t pending_bits = 0;
+    for (const Posting *posting = first; posting != last; ++posting) {
+        const size_t word = posting->slot / 64;
+        if (word != pending_word) {
+            if (pending_bits != 0) {
+                words_[pending_word] |= pending_bits;
+                pending_bits = 0;
+            }
+            if (word >= words_.size()) {
+                words_.resize(word + 1, 0);
+            }
+            pending_word = word;
+        }
+        pending_bits |= uint64_t(1) << (posting->slot % 64);
+    }
+    if (pending_bits != 0) {
+        words_[pending_word] |= pending_bits;
+    }
+}
+
+void DocumentBitmap::Reset(DocumentSlot slot) {
+    const size_t word = slot / 64;
+    if (word < words_.size()) {
+        words_[word] &= ~(uint64_t(1) << (slot % 64));
+    }
+}
+
+size_t DocumentBitmap::Count() const {
+    size_t count = 0;
+    for (const uint64_t bits: words_) {
+        count += __builtin_popcountll(bits);
+    }
+    return count;
+}
+
+void DocumentBitmap::Merge(const DocumentBitmap &other) {
+    if (words_.size() < other.words_.size()) {
+        words_.resize(other.words_.size(), 0);
+    }
+    for (size_t word = 0; word < other.words_.size(); ++word) {
+        words_[word] |= other.words_[word];
+    }
+}
+
+void DocumentBitmap::Clear() {
+    fill(words_.begin(), words_.end(), 0);
+}
+
+WordBitmapCache::WordBitmapCache(const WordBitmapCache &) {}
+
+WordBitmapCache &WordBitmapCache::operator=(const WordBitmapCache &other) {
+    if (this != &other) {
+        lock_guard guard(mutex_);
+        bitmaps_.clear();
+    }
+    return *this;
+}
+
+shared_ptr<const DocumentBitmap> WordBitmapCache::Find(TermId word, uint64_t generation) {
+    lock_guard guard(mutex_);
+    if (generation != generation_) {
+        bitmaps_.clear();
+        generation_ = generation;
+        return nullptr;
+    }
+    const auto it = bitmaps_.find(word);
+    return it == bitmaps_.end() ? nullptr : it->second;
+}
+
+void WordBitmapCache::Insert(TermId word, uint64_t generation, shared_ptr<const DocumentBitmap> bitmap) {
+    lock_guard guard(mutex_);
+    if (generation == generation_) {
+        bitmaps_[word] = move(bitmap);
+    }
+}
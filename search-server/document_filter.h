@@ -0,0 +1,84 @@
+//
+// -------- Фильтры документов ----------
+//
+
+#ifndef SEARCH_SERVER_DOCUMENT_FILTER_H
+#define SEARCH_SERVER_DOCUMENT_FILTER_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+// Множество слотов документов, бит на слот. Слоты плотные, поэтому сжатие не нужно:
+// на миллион документов - 128 КБ, а проверка слота - одно чтение слова.
+class DocumentBitmap {
+public:
+    void Set(DocumentSlot slot) {
+        const size_t word = slot / 64;
+        if (word >= words_.size()) {
+            words_.resize(word + 1, 0);
+        }
+        words_[word] |= uint64_t(1) << (slot % 64);
+    }
+
+    // Отмечает слоты вхождений [first, last). Соседние слоты копятся в регистре и записываются
+    // одним словом, а не чтением-записью памяти на каждый слот.
+    void Set(const Posting *first, const Posting *last);
+
+    void Reset(DocumentSlot slot);
+
+    [[nodiscard]] bool Test(DocumentSlot slot) const {
+        const size_t word = slot / 64;
+        return word < words_.size() && (words_[word] >> (slot % 64) & 1) != 0;
+    }
+
+    [[nodiscard]] size_t Count() const;
+
+    // Добавляет слоты other: побитовое ИЛИ по словам
+    void Merge(const DocumentBitmap &other);
+
+    // Сбрасывает все биты, память остается за битовой картой
+    void Clear();
+
+private:
+    std::vector<uint64_t> words_;
+};
+
+// Потокобезопасный кеш битовых карт документов со словом. Как и QueryCache, запись помнит поколение
+// индекса: при обращении с другим поколением кеш очищается целиком. Копия кеша пустая.
+class WordBitmapCache {
+public:
+    WordBitmapCache() = default;
+
+    WordBitmapCache(const WordBitmapCache &other);
+
+    WordBitmapCache &operator=(const WordBitmapCache &other);
+
+    [[nodiscard]] std::shared_ptr<const DocumentBitmap> Find(TermId word, uint64_t generation);
+
+    void Insert(TermId word, uint64_t generation, std::shared_ptr<const DocumentBitmap> bitmap);
+
+private:
+    std::mutex mutex_;
+    uint64_t generation_ = 0;
+    std::unordered_map<TermId, std::shared_ptr<const DocumentBitmap>> bitmaps_;
+};
+
+// Декларативный отбор документов. В отличие от произвольного предиката, сервер проверяет его
+// по битовой карте статуса и столбцу рейтингов до подсчета релевантности (см. SearchServer::FindTopDocuments).
+struct DocumentFilter {
+    // Без статуса подходят документы с любым статусом
+    std::optional<DocumentStatus> status;
+    // Рейтинг должен лежать в отрезке [min_rating, max_rating]
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+};
+
+#endif //SEARCH_SERVER_DOCUMENT_FILTER_H
@@ -0,0 +1,149 @@
+//
+// -------- Поисковой сервер с сохранением на диск ----------
+//
+
+#include "durable_search_server.h"
+
+#include <algorithm>
+#include <filesystem>
+
+using namespace std;
+
+static const string SNAPSHOT_PREFIX = "snapshot."s;
+static const string SNAPSHOT_SUFFIX = ".bin"s;
+static const string LOG_PREFIX = "wal."s;
+static const string LOG_SUFFIX = ".log"s;
+
+// Номер N из имени вида <prefix>N<suffix>, 0 - если имя другого вида
+static uint64_t ParseGeneration(const string &file_name, const string &prefix, const string &suffix) {
+    if (file_name.size() <= prefix.size() + suffix.size() || file_name.compare(0, prefix.size(), prefix) != 0 ||
+        file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return 0;
+    }
+    const string number = file_name.substr(prefix.size(), file_name.size() - prefix.size() - suffix.size());
+    if (!all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return 0;
+    }
+    return stoull(number);
+}
+
+// Удаляет журналы и снимки, все изменения из которых уже есть в снимке с номером snapshot_generation
+static void RemoveCompactedFiles(const string &directory, uint64_t snapshot_generation) {
+    for (const auto &entry: filesystem::directory_iterator(directory)) {
+        const string file_name = entry.path().filename().string();
+        const uint64_t log_generation = ParseGeneration(file_name, LOG_PREFIX, LOG_SUFFIX);
+        const uint64_t generation = ParseGeneration(file_name, SNAPSHOT_PREFIX, SNAPSHOT_SUFFIX);
+        if ((log_generation > 0 && log_generation < snapshot_generation) ||
+            (generation > 0 && generation < snapshot_generation)) {
+            filesystem::remove(entry.path());
+        }
+    }
+}
+
+DurableSearchServer::DurableSearchServer(const string &directory, string_view stop_words,
+                                         WriteAheadLogOptions options)
+        : directory_(directory), options_(options) {
+    filesystem::create_directories(directory_);
+
+    uint64_t snapshot_generation = 0;
+    vector<uint64_t> log_generations;
+    for (const auto &entry: filesystem::directory_iterator(directory_)) {
+        const string file_name = entry.path().filename().string();
+        snapshot_generation = max(snapshot_generation, ParseGeneration(file_name, SNAPSHOT_PREFIX, SNAPSHOT_SUFFIX));
+        if (const uint64_t generation = ParseGeneration(file_name, LOG_PREFIX, LOG_SUFFIX); generation > 0) {
+            log_generations.push_back(generation);
+        }
+    }
+
+    if (snapshot_generation > 0) {
+        search_server_ = SearchServer::LoadSnapshot(GetSnapshotPath(snapshot_generation));
+        // Сжатие могло прерваться после записи снимка, но до удаления старых файлов
+        RemoveCompactedFiles(directory_, snapshot_generation);
+    } else {
+        // Журнал не хранит стоп-слова, поэтому новый каталог сразу получает пустой снимок с ними
+        search_server_.SetStopWords(stop_words);
+        snapshot_generation = 1;
+        search_server_.SaveSnapshot(GetSnapshotPath(snapshot_generation));
+    }
+    generation_ = snapshot_generation;
+
+    sort(log_generations.begin(), log_generations.end());
+    for (const uint64_t generation: log_generations) {
+        if (generation < snapshot_generation) {
+            continue;
+        }
+        WriteAheadLog::Replay(GetLogPath(generation), [this](const LogRecord &record) {
+            if (record.operation == LogOperation::ADD_DOCUMENT) {
+                search_server_.AddDocument(record.document_id, record.document, record.status, record.ratings);
+            } else {
+                search_server_.RemoveDocument(record.document_id);
+            }
+        });
+        generation_ = generation;
+    }
+    log_ = make_unique<WriteAheadLog>(GetLogPath(generation_), options_);
+}
+
+DurableSearchServer::~DurableSearchServer() {
+    if (compaction_.valid()) {
+        compaction_.wait();
+    }
+}
+
+void DurableSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                      const vector<int> &ratings) {
+    // Документ проверяется при добавлении в сервер, поэтому некорректный документ не попадет в журнал.
+    // Если же не удалась запись в журнал, документ удаляется: сервер не должен содержать изменений,
+    // которых нет на диске
+    search_server_.AddDocument(document_id, document, status, ratings);
+    try {
+        log_->AppendAddDocument(document_id, document, status, ratings);
+    } catch (...) {
+        search_server_.RemoveDocument(document_id);
+        throw;
+    }
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    if (!search_server_.HasDocument(document_id)) {
+        return;
+    }
+    log_->AppendRemoveDocument(document_id);
+    search_server_.RemoveDocument(document_id);
+}
+
+void DurableSearchServer::Sync() {
+    log_->Sync();
+}
+
+void DurableSearchServer::Compact() {
+    WaitForCompaction();
+
+    // Новые изменения идут в новый журнал, а снимок с его номером покроет все предыдущие
+    log_->Sync();
+    const uint64_t snapshot_generation = ++generation_;
+    log_ = make_unique<WriteAheadLog>(GetLogPath(generation_), options_);
+
+    // Копия снимается в вызывающем потоке, пока сервер не меняется, и занимает время,
+    // пропорциональное размеру индекса. Тексты при этом не разбираются заново
+    auto search_server = make_shared<const SearchServer>(search_server_);
+    compaction_ = async(launch::async, [this, search_server, snapshot_generation]() {
+        // SaveSnapshot возвращается, когда снимок и его имя уже на диске, и только тогда старые журналы не нужны
+        search_server->SaveSnapshot(GetSnapshotPath(snapshot_generation));
+        RemoveCompactedFiles(directory_, snapshot_generation);
+    });
+}
+
+void DurableSearchServer::WaitForCompaction() {
+    if (compaction_.valid()) {
+        compaction_.get();
+    }
+}
+
+string DurableSearchServer::GetLogPath(uint64_t generation) const {
+    return (filesystem::path(directory_) / (LOG_PREFIX + to_string(generation) + LOG_SUFFIX)).string();
+}
+
+string DurableSearchServer::GetSnapshotPath(uint64_t generation) const {
+    return (filesystem::path(directory_) / (SNAPSHOT_PREFIX + to_string(generation) + SNAPSHOT_SUFFIX)).string();
+}
@@ -0,0 +1,69 @@
+//
+// -------- Поисковой сервер с сохранением на диск ----------
+//
+
+#ifndef SEARCH_SERVER_DURABLE_SEARCH_SERVER_H
+#define SEARCH_SERVER_DURABLE_SEARCH_SERVER_H
+
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// Поисковой сервер, изменения которого переживают перезапуск. Каталог хранит снимки
+// snapshot.<N>.bin и журналы wal.<N>.log: снимок N содержит все изменения из журналов
+// с номерами меньше N. При запуске загружается последний снимок и поверх него
+// проигрываются более новые журналы.
+//
+// Compact начинает новый журнал и в фоновом потоке сохраняет копию сервера в снимок,
+// после чего старые журналы и снимки удаляются. Поэтому время запуска ограничено размером
+// индекса и журнала с момента последнего сжатия, а не всей историей изменений.
+//
+// Методы вызываются из одного потока, фоновый поток работает только со своей копией сервера.
+// Копия снимается в Compact, то есть в вызывающем потоке, за время, пропорциональное размеру индекса.
+class DurableSearchServer {
+public:
+    // Стоп-слова используются, только если в каталоге еще нет снимка
+    DurableSearchServer(const std::string &directory, std::string_view stop_words,
+                        WriteAheadLogOptions options = {});
+
+    DurableSearchServer(const DurableSearchServer &) = delete;
+
+    DurableSearchServer &operator=(const DurableSearchServer &) = delete;
+
+    ~DurableSearchServer();
+
+    void
+    AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    [[nodiscard]] const SearchServer &GetSearchServer() const { return search_server_; }
+
+    // Дожидается записи на диск всех изменений
+    void Sync();
+
+    // Запускает фоновое сжатие журнала в снимок. Если предыдущее сжатие еще идет, сначала дожидается его.
+    void Compact();
+
+    // Дожидается окончания фонового сжатия и пробрасывает его ошибку, если она была
+    void WaitForCompaction();
+
+private:
+    std::string directory_;
+    WriteAheadLogOptions options_;
+    SearchServer search_server_;
+    // Номер текущего журнала
+    uint64_t generation_;
+    std::unique_ptr<WriteAheadLog> log_;
+    std::future<void> compaction_;
+
+    [[nodiscard]] std::string GetLogPath(uint64_t generation) const;
+
+    [[nodiscard]] std::string GetSnapshotPath(uint64_t generation) const;
+};
+
+#endif //SEARCH_SERVER_DURABLE_SEARCH_SERVER_H
@@ -0,0 +1,55 @@
+//
+// -------- Сброс файлов на диск ----------
+//
+
+#include "file_sync.h"
+
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+void SyncPath(const string &path) {
+#ifdef _WIN32
+    // _commit требует открытого на запись файла
+    const int fd = _open(path.c_str(), _O_WRONLY | _O_BINARY);
+    const bool synced = fd >= 0 && _commit(fd) == 0;
+    if (fd >= 0) {
+        _close(fd);
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    const bool synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    if (!synced) {
+        throw runtime_error("Can't sync file " + path + ".");
+    }
+}
+
+void SyncDirectory(const string &path) {
+#ifndef _WIN32
+    const int fd = open(path.c_str(), O_RDONLY);
+    const bool synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!synced) {
+        throw runtime_error("Can't sync directory " + path + ".");
+    }
+#endif
+}
+
+void SyncParentDirectory(const string &path) {
+    const filesystem::path parent = filesystem::path(path).parent_path();
+    SyncDirectory(parent.empty() ? "."s : parent.string());
+}
@@ -0,0 +1,21 @@
+//
+// -------- Сброс файлов на диск ----------
+//
+
+#ifndef SEARCH_SERVER_FILE_SYNC_H
+#define SEARCH_SERVER_FILE_SYNC_H
+
+#include <string>
+
+// Сбрасывает на диск содержимое файла path. Бросает runtime_error, если файл не открылся или не сбросился.
+void SyncPath(const std::string &path);
+
+// Сбрасывает на диск каталог path: без этого созданный или переименованный в нем файл может
+// пропасть при сбое питания, даже если его содержимое уже на диске. В Windows каталог открыть
+// для сброса нельзя, там NTFS сама журналирует изменения каталогов, и вызов ничего не делает.
+void SyncDirectory(const std::string &path);
+
+// Сбрасывает на диск каталог, в котором лежит файл path
+void SyncParentDirectory(const std::string &path);
+
+#endif //SEARCH_SERVER_FILE_SYNC_H
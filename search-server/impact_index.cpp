@@ -0,0 +1,161 @@
+//
+// -------- Индекс квантованных импактов ----------
+//
+
+#include "impact_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+static bool IsHigherImpact(const ImpactPosting &lhs, const ImpactPosting &rhs) {
+    return lhs.impact != rhs.impact ? lhs.impact > rhs.impact : lhs.slot < rhs.slot;
+}
+
+ImpactIndex::ImpactIndex(const ImpactIndex &other) {
+    *this = other;
+}
+
+ImpactIndex &ImpactIndex::operator=(const ImpactIndex &other) {
+    if (this != &other) {
+        lock_guard guard(other.merge_mutex_);
+        is_enabled_ = other.is_enabled_;
+        options_ = other.options_;
+        max_impact_ = other.max_impact_;
+        scale_ = other.scale_;
+        built_document_count_ = other.built_document_count_;
+        has_overflow_ = other.has_overflow_;
+        term_impacts_ = other.term_impacts_;
+        unmerged_words_ = other.unmerged_words_;
+        has_unmerged_ = other.has_unmerged_.load();
+    }
+    return *this;
+}
+
+void ImpactIndex::Rebuild(const ImpactScoreOptions &options, const vector<PostingList> &word_to_document_freqs,
+                          const InverseDocumentFreqFunction &inverse_document_freq, int document_count) {
+    if (options.impact_bits < 1 || options.impact_bits > 16) {
+        throw invalid_argument("Impact bits must be in range [1, 16].");
+    }
+    if (!(options.max_document_count_drift >= 0)) {
+        throw invalid_argument("Document count drift must be non-negative.");
+    }
+    is_enabled_ = true;
+    options_ = options;
+    max_impact_ = (1U << options_.impact_bits) - 1;
+    built_document_count_ = document_count;
+    has_overflow_ = false;
+
+    term_impacts_.assign(word_to_document_freqs.size(), TermImpacts());
+    unmerged_words_.clear();
+    has_unmerged_ = false;
+    // Шаг выбирается так, чтобы наибольший вклад занял всю разрядность
+    double max_score = 0;
+    for (TermId word = 0; word < word_to_document_freqs.size(); ++word) {
+        if (word_to_document_freqs[word].empty()) {
+            continue;
+        }
+        term_impacts_[word].inverse_document_freq = inverse_document_freq(word);
+        max_score = max(max_score, word_to_document_freqs[word].GetMaxTermFreq() *
+                                   term_impacts_[word].inverse_document_freq);
+    }
+    scale_ = max_score > 0 ? max_score / max_impact_ : 1;
+
+    for (TermId word = 0; word < word_to_document_freqs.size(); ++word) {
+        auto &term = term_impacts_[word];
+        term.postings.reserve(word_to_document_freqs[word].size());
+        for (PostingList::Cursor cursor(word_to_document_freqs[word]); !cursor.IsEnd(); cursor.NextBlock()) {
+            for (const Posting *posting = cursor.BlockBegin(), *last = cursor.BlockEnd(); posting != last; ++posting) {
+                term.postings.push_back({posting->slot, Quantize(posting->term_freq, term.inverse_document_freq)});
+            }
+        }
+        sort(term.postings.begin(), term.postings.end(), IsHigherImpact);
+    }
+}
+
+void ImpactIndex::Clear() {
+    *this = ImpactIndex();
+}
+
+void ImpactIndex::Insert(TermId word, DocumentSlot slot, double term_freq, double inverse_document_freq) {
+    if (word >= term_impacts_.size()) {
+        term_impacts_.resize(word + 1);
+    }
+    auto &term = term_impacts_[word];
+    if (term.postings.empty() && term.unmerged.empty()) {
+        term.inverse_document_freq = inverse_document_freq;
+    }
+    if (term.unmerged.empty()) {
+        unmerged_words_.push_back(word);
+    }
+    term.unmerged.push_back({slot, Quantize(term_freq, term.inverse_document_freq)});
+    has_unmerged_ = true;
+}
+
+void ImpactIndex::Erase(TermId word, DocumentSlot slot, double term_freq) {
+    auto &term = term_impacts_[word];
+    MergeUnmerged(term);
+    const ImpactPosting posting{slot, Quantize(term_freq, term.inverse_document_freq)};
+    const auto it = lower_bound(term.postings.begin(), term.postings.end(), posting, IsHigherImpact);
+    if (it != term.postings.end() && it->slot == slot) {
+        term.postings.erase(it);
+    }
+    if (term.postings.empty()) {
+        // TermId может достаться новому слову со своим IDF
+        term = TermImpacts();
+    }
+}
+
+bool ImpactIndex::IsStale(int document_count) const {
+    return has_overflow_ || abs(document_count - built_document_count_) >
+                            options_.max_document_count_drift * built_document_count_;
+}
+
+const vector<ImpactPosting> &ImpactIndex::GetPostings(TermId word) const {
+    static const vector<ImpactPosting> empty_postings;
+    MergeAllUnmerged();
+    return word < term_impacts_.size() ? term_impacts_[word].postings : empty_postings;
+}
+
+uint32_t ImpactIndex::GetMaxImpact(TermId word) const {
+    const auto &postings = GetPostings(word);
+    return postings.empty() ? 0 : postings.front().impact;
+}
+
+void ImpactIndex::MergeUnmerged(TermImpacts &term) {
+    if (term.unmerged.empty()) {
+        return;
+    }
+    sort(term.unmerged.begin(), term.unmerged.end(), IsHigherImpact);
+    const auto merged_count = static_cast<ptrdiff_t>(term.postings.size());
+    term.postings.insert(term.postings.end(), term.unmerged.begin(), term.unmerged.end());
+    inplace_merge(term.postings.begin(), term.postings.begin() + merged_count, term.postings.end(), IsHigherImpact);
+    term.unmerged.clear();
+}
+
+void ImpactIndex::MergeAllUnmerged() const {
+    if (!has_unmerged_.load()) {
+        return;
+    }
+    lock_guard guard(merge_mutex_);
+    // Пока поток ждал мьютекс, слияние мог выполнить другой запрос
+    if (!has_unmerged_.load()) {
+        return;
+    }
+    for (const TermId word: unmerged_words_) {
+        MergeUnmerged(term_impacts_[word]);
+    }
+    unmerged_words_.clear();
+    has_unmerged_ = false;
+}
+
+uint16_t ImpactIndex::Quantize(double term_freq, double inverse_document_freq) {
+    const double impact = round(term_freq * inverse_document_freq / scale_);
+    if (impact > max_impact_) {
+        has_overflow_ = true;
+        return static_cast<uint16_t>(max_impact_);
+    }
+    return static_cast<uint16_t>(max(impact, 0.0));
+}
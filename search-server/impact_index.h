@@ -0,0 +1,109 @@
+//
+// -------- Индекс квантованных импактов ----------
+//
+
+#ifndef SEARCH_SERVER_IMPACT_INDEX_H
+#define SEARCH_SERVER_IMPACT_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+struct ImpactScoreOptions {
+    // Разрядность импакта, от 1 до 16: чем больше, тем точнее релевантность
+    int impact_bits = 16;
+    // Импакты пересчитываются, когда число документов отклонилось от числа при последнем пересчете
+    // больше чем на эту долю; 0 - пересчет при каждом изменении
+    double max_document_count_drift = 0.1;
+};
+
+// Вхождение слова с готовым вкладом документа в релевантность
+struct ImpactPosting {
+    DocumentSlot slot;
+    uint16_t impact;
+};
+
+// Для каждого слова - вхождения с заранее посчитанным tf * idf, квантованным в целое число
+// шагов GetScale(). Вхождения слова упорядочены по убыванию импакта, поэтому при обходе
+// сначала встречаются документы с наибольшим вкладом.
+//
+// IDF слова фиксируется при пересчете, вхождения новых документов квантуются с ним же.
+// Пока число документов близко к числу при пересчете, IDF меняется мало; сервер пересчитывает
+// импакты, когда IsStale.
+//
+// Новые вхождения не вставляются в упорядоченный список по одному, а копятся отдельно и сливаются
+// с ним при первом обращении к вхождениям: серия добавлений стоит одного прохода по списку слова.
+// Слияние защищено мьютексом, поэтому параллельные запросы могут обращаться к индексу одновременно.
+class ImpactIndex {
+public:
+    using InverseDocumentFreqFunction = std::function<double(TermId word)>;
+
+    ImpactIndex() = default;
+
+    ImpactIndex(const ImpactIndex &other);
+
+    ImpactIndex &operator=(const ImpactIndex &other);
+
+    [[nodiscard]] bool IsEnabled() const { return is_enabled_; }
+
+    // Пересчитывает импакты всех вхождений. word_to_document_freqs - списки вхождений по TermId
+    void Rebuild(const ImpactScoreOptions &options, const std::vector<PostingList> &word_to_document_freqs,
+                 const InverseDocumentFreqFunction &inverse_document_freq, int document_count);
+
+    // Отключает индекс и освобождает память
+    void Clear();
+
+    // inverse_document_freq используется, только если у слова еще нет вхождений
+    void Insert(TermId word, DocumentSlot slot, double term_freq, double inverse_document_freq);
+
+    // term_freq должен совпадать с переданным в Insert
+    void Erase(TermId word, DocumentSlot slot, double term_freq);
+
+    // Импакты пора пересчитать: число документов ушло слишком далеко или импакт не уместился в разрядность
+    [[nodiscard]] bool IsStale(int document_count) const;
+
+    [[nodiscard]] const ImpactScoreOptions &GetOptions() const { return options_; }
+
+    // Вес единицы импакта: релевантность - сумма импактов, умноженная на шаг
+    [[nodiscard]] double GetScale() const { return scale_; }
+
+    // Наибольшая ошибка квантования одного вхождения: полшага
+    [[nodiscard]] double GetMaxError() const { return scale_ / 2; }
+
+    [[nodiscard]] const std::vector<ImpactPosting> &GetPostings(TermId word) const;
+
+    [[nodiscard]] uint32_t GetMaxImpact(TermId word) const;
+
+private:
+    struct TermImpacts {
+        double inverse_document_freq = 0;
+        // По убыванию импакта, при равном импакте - по возрастанию слота
+        std::vector<ImpactPosting> postings;
+        // Добавленные после последнего слияния, в порядке добавления
+        std::vector<ImpactPosting> unmerged;
+    };
+
+    bool is_enabled_ = false;
+    ImpactScoreOptions options_;
+    uint32_t max_impact_ = 0;
+    double scale_ = 1;
+    int built_document_count_ = 0;
+    bool has_overflow_ = false;
+    mutable std::vector<TermImpacts> term_impacts_;
+    // Слова, у которых есть неслитые вхождения; слово может встретиться несколько раз
+    mutable std::vector<TermId> unmerged_words_;
+    mutable std::atomic<bool> has_unmerged_ = false;
+    mutable std::mutex merge_mutex_;
+
+    [[nodiscard]] uint16_t Quantize(double term_freq, double inverse_document_freq);
+
+    static void MergeUnmerged(TermImpacts &term);
+
+    void MergeAllUnmerged() const;
+};
+
+#endif //SEARCH_SERVER_IMPACT_INDEX_H
@@ -0,0 +1,441 @@
+//
+// -------- Снимок индекса на диске ----------
+//
+
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include "file_sync.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SEARCH_SERVER_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace snapshot_format;
+
+static const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+
+// Записи читаются прямо из отображенного файла, поэтому их можно копировать побайтно
+static_assert(is_trivially_copyable_v<Posting> && sizeof(Posting) == 16);
+static_assert(is_trivially_copyable_v<Header> && sizeof(Header) % 8 == 0);
+
+static uint64_t AlignOffset(uint64_t offset) {
+    return (offset + 7) / 8 * 8;
+}
+
+// MAPPED FILE
+
+#ifdef SEARCH_SERVER_HAS_MMAP
+
+MappedFile::MappedFile(const string &path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can't open file " + path + ".");
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        throw runtime_error("Can't get size of file " + path + ".");
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void *data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Can't map file " + path + " to memory.");
+        }
+        data_ = static_cast<const char *>(data);
+    }
+    // Отображение остается действительным и после закрытия дескриптора
+    close(fd);
+}
+
+#else
+
+// Без mmap файл читается в память целиком. Буфер из new выровнен не хуже, чем по 8 байт,
+// как того требуют секции снимка
+MappedFile::MappedFile(const string &path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        throw runtime_error("Can't open file " + path + ".");
+    }
+    error_code error;
+    size_ = static_cast<size_t>(filesystem::file_size(path, error));
+    if (error) {
+        throw runtime_error("Can't get size of file " + path + ".");
+    }
+    if (size_ > 0) {
+        char *data = new char[size_];
+        if (!in.read(data, static_cast<streamsize>(size_))) {
+            delete[] data;
+            size_ = 0;
+            throw runtime_error("Can't read file " + path + ".");
+        }
+        data_ = data;
+    }
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+        : data_(exchange(other.data_, nullptr)), size_(exchange(other.size_, 0)) {
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        Unmap();
+        data_ = exchange(other.data_, nullptr);
+        size_ = exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    Unmap();
+}
+
+void MappedFile::Unmap() {
+    if (data_ != nullptr) {
+#ifdef SEARCH_SERVER_HAS_MMAP
+        munmap(const_cast<char *>(data_), size_);
+#else
+        delete[] data_;
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+// WRITER
+
+void IndexSnapshotWriter::AddStopWord(string_view word) {
+    stop_words_.push_back(word);
+}
+
+void IndexSnapshotWriter::AddTerm(string_view word, vector<Posting> postings) {
+    terms_.push_back({word, move(postings)});
+}
+
+void IndexSnapshotWriter::AddDocument(int document_id, int rating, DocumentStatus status, string_view text,
+                                      uint32_t word_count, vector<pair<string_view, double>> word_freqs) {
+    documents_.push_back({document_id, rating, status, text, word_count, move(word_freqs)});
+}
+
+void IndexSnapshotWriter::Write(const string &path) const {
+    vector<const TermData *> terms;
+    for (const auto &term: terms_) {
+        terms.push_back(&term);
+    }
+    sort(terms.begin(), terms.end(), [](const TermData *lhs, const TermData *rhs) {
+        return lhs->word < rhs->word;
+    });
+    vector<const DocumentData *> documents;
+    for (const auto &document: documents_) {
+        documents.push_back(&document);
+    }
+    sort(documents.begin(), documents.end(), [](const DocumentData *lhs, const DocumentData *rhs) {
+        return lhs->id < rhs->id;
+    });
+    vector<string_view> stop_words = stop_words_;
+    sort(stop_words.begin(), stop_words.end());
+
+    unordered_map<string_view, uint64_t> term_indexes;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        term_indexes.emplace(terms[i]->word, i);
+    }
+    unordered_map<int, uint32_t> document_indexes;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        document_indexes.emplace(documents[i]->id, static_cast<uint32_t>(i));
+    }
+
+    string strings;
+    auto add_string = [&strings](string_view str) {
+        const StringRef ref{strings.size(), str.size()};
+        strings.append(str);
+        return ref;
+    };
+
+    vector<StringRef> stop_word_records;
+    for (const string_view word: stop_words) {
+        stop_word_records.push_back(add_string(word));
+    }
+
+    vector<Term> term_records;
+    vector<Posting> postings;
+    for (const TermData *term: terms) {
+        term_records.push_back({add_string(term->word), postings.size(), term->postings.size()});
+        for (const Posting &posting: term->postings) {
+            postings.push_back({posting.document_id, document_indexes.at(posting.document_id), posting.term_freq});
+        }
+    }
+
+    vector<DocumentRecord> document_records;
+    vector<DocumentTerm> document_terms;
+    for (const DocumentData *document: documents) {
+        const uint64_t terms_begin = document_terms.size();
+        for (const auto &[word, term_freq]: document->word_freqs) {
+            document_terms.push_back({term_indexes.at(word), term_freq});
+        }
+        sort(document_terms.begin() + static_cast<ptrdiff_t>(terms_begin), document_terms.end(),
+             [](const DocumentTerm &lhs, const DocumentTerm &rhs) {
+                 return lhs.term < rhs.term;
+             });
+        document_records.push_back({document->id, document->rating, static_cast<int32_t>(document->status),
+                                    document->word_count, terms_begin, document_terms.size() - terms_begin,
+                                    add_string(document->text)});
+    }
+
+    Header header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = INDEX_SNAPSHOT_VERSION;
+    header.stop_word_count = static_cast<uint32_t>(stop_word_records.size());
+    header.term_count = static_cast<uint32_t>(term_records.size());
+    header.document_count = static_cast<uint32_t>(document_records.size());
+    header.posting_count = postings.size();
+    header.document_term_count = document_terms.size();
+    header.stop_words_offset = AlignOffset(sizeof(Header));
+    header.terms_offset = AlignOffset(header.stop_words_offset + stop_word_records.size() * sizeof(StringRef));
+    header.postings_offset = AlignOffset(header.terms_offset + term_records.size() * sizeof(Term));
+    header.documents_offset = AlignOffset(header.postings_offset + postings.size() * sizeof(Posting));
+    header.document_terms_offset =
+            AlignOffset(header.documents_offset + document_records.size() * sizeof(DocumentRecord));
+    header.strings_offset =
+            AlignOffset(header.document_terms_offset + document_terms.size() * sizeof(DocumentTerm));
+    header.file_size = header.strings_offset + strings.size();
+
+    const string temporary_path = path + ".tmp";
+    {
+        ofstream out(temporary_path, ios::binary | ios::trunc);
+        auto write_section = [&out](uint64_t offset, const void *data, size_t size) {
+            static const char padding[8] = {};
+            out.write(padding, static_cast<streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+            out.write(static_cast<const char *>(data), static_cast<streamsize>(size));
+        };
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        write_section(header.stop_words_offset, stop_word_records.data(),
+                      stop_word_records.size() * sizeof(StringRef));
+        write_section(header.terms_offset, term_records.data(), term_records.size() * sizeof(Term));
+        write_section(header.postings_offset, postings.data(), postings.size() * sizeof(Posting));
+        write_section(header.documents_offset, document_records.data(),
+                      document_records.size() * sizeof(DocumentRecord));
+        write_section(header.document_terms_offset, document_terms.data(),
+                      document_terms.size() * sizeof(DocumentTerm));
+        write_section(header.strings_offset, strings.data(), strings.size());
+        if (!out.flush()) {
+            throw runtime_error("Can't write index snapshot to " + temporary_path + ".");
+        }
+    }
+    // Данные сбрасываются до переименования: иначе после сбоя питания под именем снимка может оказаться
+    // недописанный файл. filesystem::rename, в отличие от rename из C, заменяет существующий файл и в Windows
+    error_code error;
+    try {
+        SyncPath(temporary_path);
+    } catch (...) {
+        filesystem::remove(temporary_path, error);
+        throw;
+    }
+    filesystem::rename(temporary_path, path, error);
+    if (error) {
+        filesystem::remove(temporary_path, error);
+        throw runtime_error("Can't replace index snapshot " + path + ".");
+    }
+    SyncParentDirectory(path);
+}
+
+// SNAPSHOT
+
+IndexSnapshot::IndexSnapshot(const string &path) : file_(path) {
+    if (file_.size() < sizeof(Header)) {
+        throw runtime_error("Index snapshot " + path + " is too short.");
+    }
+    header_ = reinterpret_cast<const Header *>(file_.data());
+    if (memcmp(header_->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw runtime_error("File " + path + " is not an index snapshot.");
+    }
+    if (header_->version != INDEX_SNAPSHOT_VERSION) {
+        throw runtime_error("Index snapshot " + path + " has unsupported version " +
+                            to_string(header_->version) + ".");
+    }
+    if (header_->file_size != file_.size()) {
+        throw runtime_error("Index snapshot " + path + " is truncated.");
+    }
+    // Секция должна быть выровнена и целиком лежать в файле
+    auto section = [this, &path](uint64_t offset, uint64_t count, size_t record_size) {
+        if (offset % 8 != 0 || offset > file_.size() || count > (file_.size() - offset) / record_size) {
+            throw runtime_error("Index snapshot " + path + " is corrupted.");
+        }
+        return file_.data() + offset;
+    };
+    stop_words_ = reinterpret_cast<const StringRef *>(
+            section(header_->stop_words_offset, header_->stop_word_count, sizeof(StringRef)));
+    terms_ = reinterpret_cast<const Term *>(section(header_->terms_offset, header_->term_count, sizeof(Term)));
+    postings_ = reinterpret_cast<const Posting *>(
+            section(header_->postings_offset, header_->posting_count, sizeof(Posting)));
+    documents_ = reinterpret_cast<const DocumentRecord *>(
+            section(header_->documents_offset, header_->document_count, sizeof(DocumentRecord)));
+    document_terms_ = reinterpret_cast<const DocumentTerm *>(
+            section(header_->document_terms_offset, header_->document_term_count, sizeof(DocumentTerm)));
+    strings_ = section(header_->strings_offset, 0, 1);
+
+    // Поиск обращается к записям по номерам и смещениям из файла без проверок,
+    // поэтому все они проверяются один раз при открытии
+    const uint64_t strings_size = file_.size() - header_->strings_offset;
+    auto check = [&path](bool valid) {
+        if (!valid) {
+            throw runtime_error("Index snapshot " + path + " is corrupted.");
+        }
+    };
+    auto check_string = [&check, strings_size](const StringRef &ref) {
+        check(ref.offset <= strings_size && ref.size <= strings_size - ref.offset);
+    };
+    for (uint32_t i = 0; i < header_->stop_word_count; ++i) {
+        check_string(stop_words_[i]);
+    }
+    for (uint32_t i = 0; i < header_->term_count; ++i) {
+        const Term &term = terms_[i];
+        check_string(term.word);
+        check(term.postings_begin <= header_->posting_count &&
+              term.posting_count <= header_->posting_count - term.postings_begin);
+    }
+    for (uint64_t i = 0; i < header_->posting_count; ++i) {
+        check(postings_[i].slot < header_->document_count);
+    }
+    for (uint32_t i = 0; i < header_->document_count; ++i) {
+        const DocumentRecord &document = documents_[i];
+        check_string(document.text);
+        check(document.status >= static_cast<int32_t>(DocumentStatus::ACTUAL) &&
+              document.status <= static_cast<int32_t>(DocumentStatus::REMOVED));
+        check(document.terms_begin <= header_->document_term_count &&
+              document.term_count <= header_->document_term_count - document.terms_begin);
+    }
+    for (uint64_t i = 0; i < header_->document_term_count; ++i) {
+        check(document_terms_[i].term < header_->term_count);
+    }
+}
+
+int IndexSnapshot::GetDocumentCount() const {
+    return static_cast<int>(header_->document_count);
+}
+
+vector<Document> IndexSnapshot::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus doc_status, int) {
+        return doc_status == status;
+    }, top_k);
+}
+
+SearchServer::MatchDocumentResult IndexSnapshot::MatchDocument(string_view raw_query, int document_id) const {
+    const auto status = static_cast<DocumentStatus>(documents_[FindDocument(document_id)].status);
+
+    const auto query = ParseQuery(raw_query);
+    vector<string_view> matched_words;
+
+    for (const uint64_t word: query.minus_words) {
+        if (ContainsDocument(word, document_id)) {
+            return {matched_words, status};
+        }
+    }
+    // Слова пронумерованы в лексикографическом порядке, поэтому совпавшие слова уже отсортированы
+    for (const uint64_t word: query.plus_words) {
+        if (ContainsDocument(word, document_id)) {
+            matched_words.push_back(GetString(terms_[word].word));
+        }
+    }
+    return {matched_words, status};
+}
+
+string_view IndexSnapshot::GetDocumentText(int document_id) const {
+    return GetString(documents_[FindDocument(document_id)].text);
+}
+
+map<string_view, double> IndexSnapshot::GetWordFrequencies(int document_id) const {
+    const auto &document = documents_[FindDocument(document_id)];
+    map<string_view, double> word_frequencies;
+    for (uint64_t i = document.terms_begin; i < document.terms_begin + document.term_count; ++i) {
+        word_frequencies.emplace_hint(word_frequencies.end(), GetString(terms_[document_terms_[i].term].word),
+                                      document_terms_[i].term_freq);
+    }
+    return word_frequencies;
+}
+
+string_view IndexSnapshot::GetString(const StringRef &ref) const {
+    return {strings_ + ref.offset, ref.size};
+}
+
+bool IndexSnapshot::IsStopWord(string_view word) const {
+    const StringRef *last = stop_words_ + header_->stop_word_count;
+    const StringRef *it = lower_bound(stop_words_, last, word, [this](const StringRef &ref, string_view value) {
+        return GetString(ref) < value;
+    });
+    return it != last && GetString(*it) == word;
+}
+
+uint64_t IndexSnapshot::FindTerm(string_view word) const {
+    const Term *last = terms_ + header_->term_count;
+    const Term *it = lower_bound(terms_, last, word, [this](const Term &term, string_view value) {
+        return GetString(term.word) < value;
+    });
+    if (it == last || GetString(it->word) != word) {
+        return header_->term_count;
+    }
+    return static_cast<uint64_t>(it - terms_);
+}
+
+uint32_t IndexSnapshot::FindDocument(int document_id) const {
+    const DocumentRecord *last = documents_ + header_->document_count;
+    const DocumentRecord *it = lower_bound(documents_, last, document_id, [](const DocumentRecord &document, int id) {
+        return document.id < id;
+    });
+    if (it == last || it->id != document_id) {
+        throw out_of_range("A nonexistent document_id was passed.");
+    }
+    return static_cast<uint32_t>(it - documents_);
+}
+
+bool IndexSnapshot::ContainsDocument(uint64_t term, int document_id) const {
+    const Posting *first = postings_ + terms_[term].postings_begin;
+    const Posting *last = first + terms_[term].posting_count;
+    const Posting *it = lower_bound(first, last, document_id, [](const Posting &posting, int id) {
+        return posting.document_id < id;
+    });
+    return it != last && it->document_id == document_id;
+}
+
+IndexSnapshot::Query IndexSnapshot::ParseQuery(string_view text) const {
+    Query query;
+    ForEachWord(text, [this, &query](string_view word, bool is_valid_word) {
+        const auto [data, is_minus] = ParseQueryToken(word, is_valid_word);
+        if (IsStopWord(data)) {
+            return;
+        }
+        const uint64_t term = FindTerm(data);
+        if (term == header_->term_count) {
+            return;
+        }
+        if (is_minus) {
+            query.minus_words.push_back(term);
+        } else {
+            query.plus_words.push_back(term);
+        }
+    });
+    for (auto *words: {&query.plus_words, &query.minus_words}) {
+        sort(words->begin(), words->end());
+        words->erase(unique(words->begin(), words->end()), words->end());
+    }
+    return query;
+}
+
+double IndexSnapshot::ComputeWordInverseDocumentFreq(uint64_t term) const {
+    return log(GetDocumentCount() / static_cast<double>(terms_[term].posting_count));
+}
@@ -0,0 +1,230 @@
+//
+// -------- Снимок индекса на диске ----------
+//
+
+#ifndef SEARCH_SERVER_INDEX_SNAPSHOT_H
+#define SEARCH_SERVER_INDEX_SNAPSHOT_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "search_server.h"
+
+// Формат снимка. Числа записываются в порядке байт машины, поэтому снимок переносится
+// только между машинами одной архитектуры. При несовместимом изменении формата
+// увеличивается INDEX_SNAPSHOT_VERSION.
+//
+//   заголовок | стоп-слова | слова | вхождения | документы | слова документов | строки
+//
+// Каждая секция - массив записей фиксированного размера, выровненный по 8 байт. Строки
+// (слова и тексты документов) лежат в последней секции, записи ссылаются на них по смещению.
+// Слова отсортированы лексикографически, документы - по id, вхождения каждого слова - по id
+// документа. Слотом документа во вхождении служит его номер в секции документов.
+const uint32_t INDEX_SNAPSHOT_VERSION = 2;
+
+namespace snapshot_format {
+    struct StringRef {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t stop_word_count;
+        uint32_t term_count;
+        uint32_t document_count;
+        uint64_t posting_count;
+        uint64_t document_term_count;
+        uint64_t stop_words_offset;
+        uint64_t terms_offset;
+        uint64_t postings_offset;
+        uint64_t documents_offset;
+        uint64_t document_terms_offset;
+        uint64_t strings_offset;
+        uint64_t file_size;
+    };
+
+    struct Term {
+        StringRef word;
+        uint64_t postings_begin;
+        uint64_t posting_count;
+    };
+
+    struct DocumentRecord {
+        int32_t id;
+        int32_t rating;
+        int32_t status;
+        // Число слов документа без стоп-слов
+        uint32_t word_count;
+        uint64_t terms_begin;
+        uint64_t term_count;
+        StringRef text;
+    };
+
+    // Слово документа: номер слова в секции слов и его частота в документе
+    struct DocumentTerm {
+        uint64_t term;
+        double term_freq;
+    };
+}
+
+// Отображение файла в память только для чтения. Страницы подгружаются при обращении
+// и делятся между всеми процессами, отобразившими тот же файл. Там, где нет mmap (Windows),
+// файл читается в память целиком.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    ~MappedFile();
+
+    [[nodiscard]] const char *data() const { return data_; }
+
+    [[nodiscard]] size_t size() const { return size_; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+
+    void Unmap();
+};
+
+// Собирает снимок из состояния поискового сервера (см. SearchServer::SaveSnapshot).
+// Переданные строки не копируются и должны жить до вызова Write.
+class IndexSnapshotWriter {
+public:
+    void AddStopWord(std::string_view word);
+
+    // Вхождения в postings должны быть отсортированы по document_id
+    void AddTerm(std::string_view word, std::vector<Posting> postings);
+
+    void AddDocument(int document_id, int rating, DocumentStatus status, std::string_view text, uint32_t word_count,
+                     std::vector<std::pair<std::string_view, double>> word_freqs);
+
+    // Пишет снимок во временный файл и переименовывает его в path, чтобы читатели
+    // никогда не видели недописанный снимок. Файл и каталог сбрасываются на диск до возврата,
+    // поэтому снимок переживает сбой питания
+    void Write(const std::string &path) const;
+
+private:
+    struct TermData {
+        std::string_view word;
+        std::vector<Posting> postings;
+    };
+
+    struct DocumentData {
+        int id;
+        int rating;
+        DocumentStatus status;
+        std::string_view text;
+        uint32_t word_count;
+        std::vector<std::pair<std::string_view, double>> word_freqs;
+    };
+
+    std::vector<std::string_view> stop_words_;
+    std::vector<TermData> terms_;
+    std::vector<DocumentData> documents_;
+};
+
+// Поиск по снимку без загрузки в память: все структуры читаются прямо из отображенного файла.
+// При открытии номера и смещения во всех записях сверяются с размерами секций (тексты документов
+// при этом не читаются), испорченный снимок отвергается с runtime_error. Результаты поиска совпадают с результатами
+// сервера, с которого снят снимок, релевантность - с точностью до порядка суммирования.
+class IndexSnapshot {
+public:
+    // Загружает снимок в изменяемый сервер без повторного разбора текстов
+    friend SearchServer SearchServer::LoadSnapshot(const std::string &path);
+
+    explicit IndexSnapshot(const std::string &path);
+
+    [[nodiscard]] int GetDocumentCount() const;
+
+    template<typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    [[nodiscard]] std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                     size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    [[nodiscard]] SearchServer::MatchDocumentResult MatchDocument(std::string_view raw_query, int document_id) const;
+
+    [[nodiscard]] std::string_view GetDocumentText(int document_id) const;
+
+    [[nodiscard]] std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+private:
+    MappedFile file_;
+    const snapshot_format::Header *header_;
+    const snapshot_format::StringRef *stop_words_;
+    const snapshot_format::Term *terms_;
+    const Posting *postings_;
+    const snapshot_format::DocumentRecord *documents_;
+    const snapshot_format::DocumentTerm *document_terms_;
+    const char *strings_;
+
+    struct Query {
+        std::vector<uint64_t> plus_words;
+        std::vector<uint64_t> minus_words;
+    };
+
+    [[nodiscard]] std::string_view GetString(const snapshot_format::StringRef &ref) const;
+
+    [[nodiscard]] bool IsStopWord(std::string_view word) const;
+
+    // Номер слова в секции слов или term_count, если слова нет
+    [[nodiscard]] uint64_t FindTerm(std::string_view word) const;
+
+    // Номер документа в секции документов, если документа нет - out_of_range
+    [[nodiscard]] uint32_t FindDocument(int document_id) const;
+
+    [[nodiscard]] bool ContainsDocument(uint64_t term, int document_id) const;
+
+    [[nodiscard]] Query ParseQuery(std::string_view text) const;
+
+    [[nodiscard]] double ComputeWordInverseDocumentFreq(uint64_t term) const;
+};
+
+template<typename DocumentPredicate>
+std::vector<Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query,
+                                                      DocumentPredicate document_predicate, size_t top_k) const {
+    const auto query = ParseQuery(raw_query);
+
+    ScratchScoreAccumulator document_to_relevance(header_->document_count);
+    for (const uint64_t word: query.plus_words) {
+        const auto &term = terms_[word];
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        const Posting *last = postings_ + term.postings_begin + term.posting_count;
+        for (const Posting *posting = postings_ + term.postings_begin; posting != last; ++posting) {
+            const auto &document = documents_[posting->slot];
+            if (document_predicate(document.id, static_cast<DocumentStatus>(document.status), document.rating)) {
+                document_to_relevance->Add(posting->slot, posting->term_freq * inverse_document_freq);
+            }
+        }
+    }
+    for (const uint64_t word: query.minus_words) {
+        const auto &term = terms_[word];
+        const Posting *last = postings_ + term.postings_begin + term.posting_count;
+        for (const Posting *posting = postings_ + term.postings_begin; posting != last; ++posting) {
+            document_to_relevance->Erase(posting->slot);
+        }
+    }
+
+    TopDocuments top_documents(top_k);
+    document_to_relevance->ForEach([&](DocumentSlot slot, double relevance) {
+        top_documents.Add(Document(documents_[slot].id, relevance, documents_[slot].rating));
+    });
+    return top_documents.Build();
+}
+
+#endif //SEARCH_SERVER_INDEX_SNAPSHOT_H
@@ -1,12 +1,16 @@
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include "search_server.h"
 #include "test_example_functions.h"
 
 using namespace std;
 
 int main() {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
+#endif
     TestSearchServer();
     
     return 0;
@@ -0,0 +1,467 @@
+//
+// -------- Списки вхождений слов ----------
+//
+
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include "scratch_object.h"
+#include "stream_vbyte.h"
+
+using namespace std;
+
+static bool PostingLess(const Posting &posting, int document_id) {
+    return posting.document_id < document_id;
+}
+
+// Шаг удваивается, пока не перепрыгнем искомый id, затем бинарный поиск на последнем шаге
+static const Posting *GallopLowerBound(const Posting *first, const Posting *last, int document_id) {
+    if (first == last || first->document_id >= document_id) {
+        return first;
+    }
+    size_t step = 1;
+    while (static_cast<size_t>(last - first) > step && first[step].document_id < document_id) {
+        first += step;
+        step *= 2;
+    }
+    return lower_bound(first, first + min(step, static_cast<size_t>(last - first)), document_id, PostingLess);
+}
+
+// MEMORY USAGE
+
+PostingsMemoryUsage &PostingsMemoryUsage::operator+=(const PostingsMemoryUsage &other) {
+    posting_count += other.posting_count;
+    uncompressed_bytes += other.uncompressed_bytes;
+    plain_bytes += other.plain_bytes;
+    compressed_bytes += other.compressed_bytes;
+    return *this;
+}
+
+ostream &operator<<(ostream &out, const PostingsMemoryUsage &usage) {
+    const size_t used_bytes = usage.plain_bytes + usage.compressed_bytes;
+    out << "{ "s
+        << "postings = "s << usage.posting_count << ", "s
+        << "uncompressed = "s << usage.uncompressed_bytes << " B, "s
+        << "plain = "s << usage.plain_bytes << " B, "s
+        << "compressed = "s << usage.compressed_bytes << " B, "s
+        << "ratio = "s << (used_bytes == 0 ? 1.0 : static_cast<double>(usage.uncompressed_bytes) / used_bytes)
+        << " }"s;
+    return out;
+}
+
+// MODIFICATION
+
+void PostingList::Insert(int document_id, DocumentSlot slot, double term_freq) {
+    max_term_freq_ = max(max_term_freq_, term_freq);
+    const bool is_after_blocks = blocks_.empty() || blocks_.back().last_document_id < document_id;
+    if (is_after_blocks && (postings_.empty() || postings_.back().document_id < document_id)) {
+        postings_.push_back({document_id, slot, term_freq});
+        return;
+    }
+    if (!is_after_blocks) {
+        Decompress();
+    }
+    auto it = LowerBound(document_id);
+    if (it != postings_.end() && it->document_id == document_id && IsErased(*it)) {
+        *it = {document_id, slot, term_freq};
+        --erased_count_;
+    } else if (it != postings_.end() && it->document_id == document_id) {
+        it->term_freq += term_freq;
+        max_term_freq_ = max(max_term_freq_, it->term_freq);
+    } else {
+        postings_.insert(it, {document_id, slot, term_freq});
+    }
+}
+
+void PostingList::Insert(const Posting *first, const Posting *last) {
+    if (first == last) {
+        return;
+    }
+    for (const Posting *posting = first; posting != last; ++posting) {
+        max_term_freq_ = max(max_term_freq_, posting->term_freq);
+    }
+    const int first_id = first->document_id;
+    if (!blocks_.empty() && first_id <= blocks_.back().last_document_id) {
+        Decompress();
+    }
+    const bool is_after_postings = postings_.empty() || postings_.back().document_id < first_id;
+    if (!is_after_postings) {
+        // Слияние и так проходит весь массив, а помеченное вхождение не должно оказаться рядом с живым
+        RemoveErasedPostings(false);
+    }
+    const auto middle = postings_.insert(postings_.end(), first, last);
+    if (!is_after_postings) {
+        inplace_merge(postings_.begin(), middle, postings_.end(),
+                      [](const Posting &lhs, const Posting &rhs) { return lhs.document_id < rhs.document_id; });
+    }
+}
+
+bool PostingList::Erase(int document_id) {
+    if (!blocks_.empty() && document_id <= blocks_.back().last_document_id) {
+        if (EraseFromBlock(FindBlock(document_id), &document_id, &document_id + 1) == 0) {
+            return false;
+        }
+    } else {
+        auto it = LowerBound(document_id);
+        if (it == postings_.end() || it->document_id != document_id || IsErased(*it)) {
+            return false;
+        }
+        it->slot = ERASED_SLOT;
+        ++erased_count_;
+        RemoveErasedPostings(true);
+    }
+    if (empty()) {
+        max_term_freq_ = 0;
+    }
+    return true;
+}
+
+size_t PostingList::Erase(const vector<int> &document_ids) {
+    const int *id = document_ids.data();
+    const int *ids_end = id + document_ids.size();
+    size_t erased_count = 0;
+
+    // Документы сжатой части удаляются поблочно, каждый затронутый блок перекодируется один раз
+    for (size_t block_index = 0; id != ids_end && !blocks_.empty() && *id <= blocks_.back().last_document_id;) {
+        // Поиск начинается с последнего затронутого блока: если он опустел, на его месте уже следующий
+        block_index = FindBlock(*id, block_index);
+        const int *block_ids_end = upper_bound(id, ids_end, blocks_[block_index].last_document_id);
+        erased_count += EraseFromBlock(block_index, id, block_ids_end);
+        id = block_ids_end;
+    }
+
+    const Posting *position = postings_.data();
+    const Posting *postings_end = position + postings_.size();
+    for (; id != ids_end; ++id) {
+        position = GallopLowerBound(position, postings_end, *id);
+        if (position == postings_end) {
+            break;
+        }
+        if (position->document_id == *id && !IsErased(*position)) {
+            postings_[position - postings_.data()].slot = ERASED_SLOT;
+            ++erased_count_;
+            ++erased_count;
+        }
+    }
+    RemoveErasedPostings(true);
+
+    if (empty()) {
+        max_term_freq_ = 0;
+    }
+    return erased_count;
+}
+
+bool PostingList::Contains(int document_id) const {
+    if (!blocks_.empty() && document_id <= blocks_.back().last_document_id) {
+        const size_t block_index = FindBlock(document_id);
+        Posting buffer[POSTING_BLOCK_SIZE];
+        DecodeBlock(block_index, buffer);
+        const Posting *block_end = buffer + blocks_[block_index].size;
+        const Posting *it = lower_bound(static_cast<const Posting *>(buffer), block_end, document_id, PostingLess);
+        return it != block_end && it->document_id == document_id;
+    }
+    auto it = LowerBound(document_id);
+    return it != postings_.end() && it->document_id == document_id && !IsErased(*it);
+}
+
+size_t PostingList::EraseFromBlock(size_t block_index, const int *first, const int *last) {
+    Block &block = blocks_[block_index];
+    uint32_t document_ids[POSTING_BLOCK_SIZE], slots[POSTING_BLOCK_SIZE];
+    uint32_t term_counts[POSTING_BLOCK_SIZE], word_counts[POSTING_BLOCK_SIZE];
+    const uint8_t *in = block_bytes_.data() + block.offset;
+    in = DecodeStreamVByte(in, block.size, document_ids);
+    in = DecodeStreamVByte(in, block.size, slots);
+    in = DecodeStreamVByte(in, block.size, term_counts);
+    in = DecodeStreamVByte(in, block.size, word_counts);
+    const size_t old_byte_size = in - (block_bytes_.data() + block.offset);
+    PrefixSumDeltas(document_ids, block.size, static_cast<uint32_t>(block.base_document_id));
+
+    uint32_t kept_count = 0;
+    for (uint32_t i = 0; i < block.size; ++i) {
+        while (first != last && *first < static_cast<int>(document_ids[i])) {
+            ++first;
+        }
+        if (first != last && *first == static_cast<int>(document_ids[i])) {
+            continue;
+        }
+        document_ids[kept_count] = document_ids[i];
+        slots[kept_count] = slots[i];
+        term_counts[kept_count] = term_counts[i];
+        word_counts[kept_count] = word_counts[i];
+        ++kept_count;
+    }
+    const size_t erased_count = block.size - kept_count;
+    if (erased_count == 0) {
+        return 0;
+    }
+    compressed_count_ -= erased_count;
+
+    if (kept_count == 0) {
+        unused_block_bytes_ += old_byte_size;
+        blocks_.erase(blocks_.begin() + static_cast<ptrdiff_t>(block_index));
+    } else {
+        // Сумма двух разностей занимает не больше байт, чем они вместе, поэтому блок помещается на старое место
+        const int last_document_id = static_cast<int>(document_ids[kept_count - 1]);
+        for (uint32_t i = kept_count; i-- > 1;) {
+            document_ids[i] -= document_ids[i - 1];
+        }
+        document_ids[0] -= static_cast<uint32_t>(block.base_document_id);
+        ScratchObject<vector<uint8_t>> bytes;
+        bytes->clear();
+        for (const uint32_t *values: {document_ids, slots, term_counts, word_counts}) {
+            EncodeStreamVByte(values, kept_count, *bytes);
+        }
+        copy(bytes->begin(), bytes->end(), block_bytes_.begin() + block.offset);
+        unused_block_bytes_ += old_byte_size - bytes->size();
+        block.size = kept_count;
+        block.last_document_id = last_document_id;
+    }
+    ReleaseUnusedBlockBytes();
+    return erased_count;
+}
+
+// COMPRESSION
+
+void PostingList::Compress(const WordCountFunction &word_count) {
+    RemoveErasedPostings(false);
+    if (postings_.empty()) {
+        return;
+    }
+    if (!block_bytes_.empty()) {
+        block_bytes_.resize(block_bytes_.size() - STREAM_VBYTE_PADDING);
+    }
+    vector<uint32_t> deltas, slots, term_counts, word_counts;
+    for (size_t first = 0; first < postings_.size(); first += POSTING_BLOCK_SIZE) {
+        const size_t last = min(first + POSTING_BLOCK_SIZE, postings_.size());
+        Block block{blocks_.empty() ? 0 : blocks_.back().last_document_id, postings_[last - 1].document_id,
+                    static_cast<uint32_t>(last - first), static_cast<uint32_t>(block_bytes_.size())};
+
+        deltas.clear();
+        slots.clear();
+        term_counts.clear();
+        word_counts.clear();
+        int previous_document_id = block.base_document_id;
+        for (size_t i = first; i < last; ++i) {
+            const Posting &posting = postings_[i];
+            const uint32_t document_word_count = word_count(posting.document_id);
+            deltas.push_back(static_cast<uint32_t>(posting.document_id - previous_document_id));
+            slots.push_back(posting.slot);
+            term_counts.push_back(static_cast<uint32_t>(llround(posting.term_freq * document_word_count)));
+            word_counts.push_back(document_word_count);
+            previous_document_id = posting.document_id;
+        }
+        for (const auto *values: {&deltas, &slots, &term_counts, &word_counts}) {
+            EncodeStreamVByte(values->data(), values->size(), block_bytes_);
+        }
+        blocks_.push_back(block);
+    }
+    block_bytes_.resize(block_bytes_.size() + STREAM_VBYTE_PADDING, 0);
+    block_bytes_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+
+    compressed_count_ += postings_.size();
+    postings_.clear();
+    postings_.shrink_to_fit();
+}
+
+void PostingList::Decompress() {
+    if (blocks_.empty()) {
+        return;
+    }
+    vector<Posting> postings(compressed_count_ + postings_.size());
+    for (size_t block_index = 0, offset = 0; block_index < blocks_.size(); ++block_index) {
+        DecodeBlock(block_index, postings.data() + offset);
+        offset += blocks_[block_index].size;
+    }
+    copy(postings_.begin(), postings_.end(), postings.begin() + static_cast<ptrdiff_t>(compressed_count_));
+
+    postings_ = move(postings);
+    blocks_.clear();
+    blocks_.shrink_to_fit();
+    block_bytes_.clear();
+    block_bytes_.shrink_to_fit();
+    unused_block_bytes_ = 0;
+    compressed_count_ = 0;
+}
+
+size_t PostingList::GetBlockByteSize(size_t block_index) const {
+    const Block &block = blocks_[block_index];
+    const uint8_t *in = block_bytes_.data() + block.offset;
+    size_t byte_size = 0;
+    for (int stream = 0; stream < 4; ++stream) {
+        byte_size += GetStreamVByteSize(in + byte_size, block.size);
+    }
+    return byte_size;
+}
+
+void PostingList::ReleaseUnusedBlockBytes() {
+    if (blocks_.empty()) {
+        blocks_.shrink_to_fit();
+        block_bytes_.clear();
+        block_bytes_.shrink_to_fit();
+        unused_block_bytes_ = 0;
+        return;
+    }
+    if (2 * unused_block_bytes_ <= block_bytes_.size() - STREAM_VBYTE_PADDING) {
+        return;
+    }
+    vector<uint8_t> block_bytes;
+    block_bytes.reserve(block_bytes_.size() - unused_block_bytes_);
+    for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+        const auto first = block_bytes_.begin() + blocks_[block_index].offset;
+        const size_t byte_size = GetBlockByteSize(block_index);
+        blocks_[block_index].offset = static_cast<uint32_t>(block_bytes.size());
+        block_bytes.insert(block_bytes.end(), first, first + static_cast<ptrdiff_t>(byte_size));
+    }
+    block_bytes.resize(block_bytes.size() + STREAM_VBYTE_PADDING, 0);
+    block_bytes_ = move(block_bytes);
+    blocks_.shrink_to_fit();
+    unused_block_bytes_ = 0;
+}
+
+void PostingList::RemoveErasedPostings(bool sparse_only) {
+    if (erased_count_ == 0 || (sparse_only && 4 * erased_count_ <= postings_.size())) {
+        return;
+    }
+    postings_.erase(remove_if(postings_.begin(), postings_.end(), IsErased), postings_.end());
+    erased_count_ = 0;
+}
+
+void PostingList::DecodeBlock(size_t block_index, Posting *buffer) const {
+    const Block &block = blocks_[block_index];
+    uint32_t document_ids[POSTING_BLOCK_SIZE], slots[POSTING_BLOCK_SIZE];
+    uint32_t term_counts[POSTING_BLOCK_SIZE], word_counts[POSTING_BLOCK_SIZE];
+
+    const uint8_t *in = block_bytes_.data() + block.offset;
+    in = DecodeStreamVByte(in, block.size, document_ids);
+    in = DecodeStreamVByte(in, block.size, slots);
+    in = DecodeStreamVByte(in, block.size, term_counts);
+    DecodeStreamVByte(in, block.size, word_counts);
+    PrefixSumDeltas(document_ids, block.size, static_cast<uint32_t>(block.base_document_id));
+
+    for (size_t i = 0; i < block.size; ++i) {
+        // То же выражение, что и при добавлении документа, поэтому частота совпадает до бита
+        const double inv_word_count = 1 / static_cast<double>(word_counts[i]);
+        buffer[i] = {static_cast<int>(document_ids[i]), slots[i], static_cast<double>(term_counts[i]) * inv_word_count};
+    }
+}
+
+PostingsMemoryUsage PostingList::GetMemoryUsage() const {
+    PostingsMemoryUsage usage;
+    usage.posting_count = size();
+    usage.uncompressed_bytes = size() * sizeof(Posting);
+    usage.plain_bytes = postings_.capacity() * sizeof(Posting);
+    usage.compressed_bytes = block_bytes_.capacity() + blocks_.capacity() * sizeof(Block);
+    return usage;
+}
+
+// SEARCH
+
+vector<Posting>::iterator PostingList::LowerBound(int document_id) {
+    return lower_bound(postings_.begin(), postings_.end(), document_id, PostingLess);
+}
+
+vector<Posting>::const_iterator PostingList::LowerBound(int document_id) const {
+    return lower_bound(postings_.begin(), postings_.end(), document_id, PostingLess);
+}
+
+size_t PostingList::FindBlock(int document_id, size_t first_block) const {
+    return lower_bound(blocks_.begin() + static_cast<ptrdiff_t>(first_block), blocks_.end(), document_id,
+                       [](const Block &block, int id) {
+                           return block.last_document_id < id;
+                       }) - blocks_.begin();
+}
+
+// CURSOR
+
+PostingList::Cursor::Cursor(const PostingList &postings) : postings_(&postings) {
+    Load(0);
+}
+
+PostingList::Cursor::Cursor(const Cursor &other) {
+    *this = other;
+}
+
+PostingList::Cursor &PostingList::Cursor::operator=(const Cursor &other) {
+    postings_ = other.postings_;
+    block_index_ = other.block_index_;
+    plain_next_ = other.plain_next_;
+    if (other.IsBuffered()) {
+        // Указатели копии должны смотреть в ее собственный буфер
+        const size_t size = other.end_ - other.buffer_.data();
+        copy(other.buffer_.begin(), other.buffer_.begin() + size, buffer_.begin());
+        current_ = buffer_.data() + (other.current_ - other.buffer_.data());
+        end_ = buffer_.data() + size;
+    } else {
+        current_ = other.current_;
+        end_ = other.end_;
+    }
+    return *this;
+}
+
+void PostingList::Cursor::Next() {
+    if (++current_ == end_) {
+        NextBlock();
+    }
+}
+
+void PostingList::Cursor::NextBlock() {
+    if (block_index_ < postings_->blocks_.size()) {
+        Load(block_index_ + 1);
+    } else if (IsBuffered() && plain_next_ < postings_->postings_.size()) {
+        LoadPlain();
+    } else {
+        current_ = end_;
+    }
+}
+
+void PostingList::Cursor::Seek(int document_id) {
+    if (IsEnd() || current_->document_id >= document_id) {
+        return;
+    }
+    if (block_index_ < postings_->blocks_.size() &&
+        postings_->blocks_[block_index_].last_document_id < document_id) {
+        Load(postings_->FindBlock(document_id, block_index_ + 1));
+    }
+    // Непустая порция несжатой части, все вхождения которой меньше document_id, заменяется следующей
+    const vector<Posting> &postings = postings_->postings_;
+    if (block_index_ == postings_->blocks_.size() && IsBuffered() && plain_next_ < postings.size() &&
+        (end_ - 1)->document_id < document_id) {
+        plain_next_ = GallopLowerBound(postings.data() + plain_next_, postings.data() + postings.size(), document_id) -
+                      postings.data();
+        LoadPlain();
+    }
+    current_ = GallopLowerBound(current_, end_, document_id);
+}
+
+void PostingList::Cursor::Load(size_t block_index) {
+    block_index_ = block_index;
+    if (block_index_ < postings_->blocks_.size()) {
+        postings_->DecodeBlock(block_index_, buffer_.data());
+        current_ = buffer_.data();
+        end_ = current_ + postings_->blocks_[block_index_].size;
+    } else if (postings_->erased_count_ > 0) {
+        plain_next_ = 0;
+        LoadPlain();
+    } else {
+        current_ = postings_->postings_.data();
+        end_ = current_ + postings_->postings_.size();
+    }
+}
+
+bool PostingList::Cursor::IsBuffered() const {
+    return block_index_ < postings_->blocks_.size() || postings_->erased_count_ > 0;
+}
+
+void PostingList::Cursor::LoadPlain() {
+    const vector<Posting> &postings = postings_->postings_;
+    size_t size = 0;
+    for (; plain_next_ < postings.size() && size < buffer_.size(); ++plain_next_) {
+        if (!IsErased(postings[plain_next_])) {
+            buffer_[size++] = postings[plain_next_];
+        }
+    }
+    current_ = buffer_.data();
+    end_ = current_ + size;
+}
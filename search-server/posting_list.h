@@ -0,0 +1,177 @@
+//
+// -------- Списки вхождений слов ----------
+//
+
+#ifndef SEARCH_SERVER_POSTING_LIST_H
+#define SEARCH_SERVER_POSTING_LIST_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+// Внутренний плотный номер документа (0, 1, 2, ...), освободившиеся номера переиспользуются
+using DocumentSlot = uint32_t;
+
+struct Posting {
+    int document_id;
+    DocumentSlot slot;
+    double term_freq;
+};
+
+struct PostingsMemoryUsage {
+    size_t posting_count = 0;
+    // Столько занимали бы все вхождения в несжатом виде
+    size_t uncompressed_bytes = 0;
+    // Фактически занято несжатыми и сжатыми вхождениями
+    size_t plain_bytes = 0;
+    size_t compressed_bytes = 0;
+
+    PostingsMemoryUsage &operator+=(const PostingsMemoryUsage &other);
+};
+
+std::ostream &operator<<(std::ostream &out, const PostingsMemoryUsage &usage);
+
+const uint32_t POSTING_BLOCK_SIZE = 128;
+
+// Список документов, содержащих слово, отсортированный по document_id.
+//
+// Несжатые вхождения хранятся одним непрерывным массивом. Документы обычно добавляются
+// по возрастанию id, поэтому вставка в конец - основной случай; вставка "в середину"
+// сдвигает хвост массива. Удаленное несжатое вхождение только помечается, курсор его пропускает,
+// а массив уплотняется, когда помеченных становится больше четверти.
+//
+// После Compress вхождения упаковываются в блоки по POSTING_BLOCK_SIZE: разности id, слоты,
+// число вхождений слова и число слов документа кодируются Stream VByte. Частота слова
+// восстанавливается из двух последних чисел без потери точности. Документы с id больше
+// последнего сжатого дописываются в несжатый хвост, а вставка в сжатую часть распаковывает список.
+// Удаление из сжатой части перекодирует только свой блок на его же месте: без вхождения блок
+// не становится длиннее. Освободившиеся байты собираются, когда их больше половины.
+class PostingList {
+public:
+    class Cursor;
+
+    // Возвращает число слов (без стоп-слов) в документе
+    using WordCountFunction = std::function<uint32_t(int document_id)>;
+
+    void Insert(int document_id, DocumentSlot slot, double term_freq);
+
+    // Добавляет вхождения новых документов, отсортированные по id
+    void Insert(const Posting *first, const Posting *last);
+
+    bool Erase(int document_id);
+
+    // Удаляет вхождения документов из отсортированного document_ids за один проход по списку,
+    // возвращает число удаленных
+    size_t Erase(const std::vector<int> &document_ids);
+
+    [[nodiscard]] bool Contains(int document_id) const;
+
+    void Compress(const WordCountFunction &word_count);
+
+    void Decompress();
+
+    // Верхняя оценка term_freq по списку: после удалений может быть больше фактического максимума
+    [[nodiscard]] double GetMaxTermFreq() const { return max_term_freq_; }
+
+    [[nodiscard]] PostingsMemoryUsage GetMemoryUsage() const;
+
+    [[nodiscard]] size_t size() const { return compressed_count_ + postings_.size() - erased_count_; }
+
+    [[nodiscard]] bool empty() const { return size() == 0; }
+
+private:
+    struct Block {
+        int base_document_id;
+        int last_document_id;
+        uint32_t size;
+        uint32_t offset;
+    };
+
+    // Слот помеченного удаленным несжатого вхождения
+    static constexpr DocumentSlot ERASED_SLOT = UINT32_MAX;
+
+    std::vector<Block> blocks_;
+    std::vector<uint8_t> block_bytes_;
+    // Байты block_bytes_, которые не принадлежат ни одному блоку
+    size_t unused_block_bytes_ = 0;
+    size_t compressed_count_ = 0;
+    std::vector<Posting> postings_;
+    // Сколько вхождений postings_ помечено удаленными
+    size_t erased_count_ = 0;
+    double max_term_freq_ = 0;
+
+    [[nodiscard]] static bool IsErased(const Posting &posting) { return posting.slot == ERASED_SLOT; }
+
+    [[nodiscard]] std::vector<Posting>::iterator LowerBound(int document_id);
+
+    [[nodiscard]] std::vector<Posting>::const_iterator LowerBound(int document_id) const;
+
+    // Первый блок, в котором может встретиться document_id, или blocks_.size()
+    [[nodiscard]] size_t FindBlock(int document_id, size_t first_block = 0) const;
+
+    // Декодирует блок в buffer, где должно быть место для POSTING_BLOCK_SIZE вхождений
+    void DecodeBlock(size_t block_index, Posting *buffer) const;
+
+    [[nodiscard]] size_t GetBlockByteSize(size_t block_index) const;
+
+    // Удаляет из блока вхождения документов из отсортированного [first, last), возвращает число удаленных.
+    // Опустевший блок убирается из списка.
+    size_t EraseFromBlock(size_t block_index, const int *first, const int *last);
+
+    // Уплотняет block_bytes_, если неиспользуемых байт в нем больше половины
+    void ReleaseUnusedBlockBytes();
+
+    // Убирает помеченные удаленными несжатые вхождения; если sparse_only, то только когда их больше четверти
+    void RemoveErasedPostings(bool sparse_only);
+};
+
+// Последовательный обход списка с переходом к заданному id, в сжатой части блоки декодируются по одному
+// во встроенный буфер курсора, поэтому обход не выделяет память
+class PostingList::Cursor {
+public:
+    explicit Cursor(const PostingList &postings);
+
+    Cursor(const Cursor &other);
+
+    Cursor &operator=(const Cursor &other);
+
+    [[nodiscard]] bool IsEnd() const { return current_ == end_; }
+
+    const Posting &operator*() const { return *current_; }
+
+    const Posting *operator->() const { return current_; }
+
+    void Next();
+
+    // Переходит к первому вхождению с id не меньше document_id, назад курсор не двигается
+    void Seek(int document_id);
+
+    // Вхождения от текущего до конца декодированного блока лежат в памяти подряд,
+    // полный обход списка - цикл по [BlockBegin(), BlockEnd()) с переходом NextBlock()
+    [[nodiscard]] const Posting *BlockBegin() const { return current_; }
+
+    [[nodiscard]] const Posting *BlockEnd() const { return end_; }
+
+    void NextBlock();
+
+private:
+    const PostingList *postings_;
+    size_t block_index_ = 0;
+    // Если в несжатой части есть помеченные удаленными, живые вхождения копируются в buffer_ порциями,
+    // plain_next_ - номер первого не скопированного
+    size_t plain_next_ = 0;
+    std::array<Posting, POSTING_BLOCK_SIZE> buffer_;
+    const Posting *current_ = nullptr;
+    const Posting *end_ = nullptr;
+
+    void Load(size_t block_index);
+
+    // Текущие вхождения лежат в buffer_
+    [[nodiscard]] bool IsBuffered() const;
+
+    void LoadPlain();
+};
+
+#endif //SEARCH_SERVER_POSTING_LIST_H
@@ -0,0 +1,96 @@
+//
+// -------- Кеш результатов запросов ----------
+//
+
+#include "query_cache.h"
+
+using namespace std;
+
+QueryCache::QueryCache(size_t capacity) : capacity_(capacity) {}
+
+QueryCache::QueryCache(const QueryCache &other) : capacity_(other.GetCapacity()) {}
+
+QueryCache &QueryCache::operator=(const QueryCache &other) {
+    if (this != &other) {
+        const size_t capacity = other.GetCapacity();
+        lock_guard guard(mutex_);
+        capacity_ = capacity;
+        entries_.clear();
+        index_.clear();
+        statistics_ = {};
+    }
+    return *this;
+}
+
+void QueryCache::SetCapacity(size_t capacity) {
+    lock_guard guard(mutex_);
+    capacity_ = capacity;
+    EvictOverCapacity();
+}
+
+size_t QueryCache::GetCapacity() const {
+    lock_guard guard(mutex_);
+    return capacity_;
+}
+
+bool QueryCache::IsEnabled() const {
+    lock_guard guard(mutex_);
+    return capacity_ > 0;
+}
+
+optional<vector<Document>> QueryCache::Find(const string &key, uint64_t generation) {
+    vector<Document> documents;
+    if (!Find(key, generation, documents)) {
+        return nullopt;
+    }
+    return documents;
+}
+
+bool QueryCache::Find(const string &key, uint64_t generation, vector<Document> &documents) {
+    lock_guard guard(mutex_);
+    const auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++statistics_.misses;
+        return false;
+    }
+    if (it->second->generation != generation) {
+        entries_.erase(it->second);
+        index_.erase(it);
+        ++statistics_.misses;
+        return false;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ++statistics_.hits;
+    documents.assign(it->second->documents.begin(), it->second->documents.end());
+    return true;
+}
+
+void QueryCache::Insert(const string &key, uint64_t generation, const vector<Document> &documents) {
+    lock_guard guard(mutex_);
+    if (capacity_ == 0) {
+        return;
+    }
+    if (const auto it = index_.find(key); it != index_.end()) {
+        // Другой поток мог посчитать тот же запрос одновременно с этим
+        it->second->generation = generation;
+        it->second->documents = documents;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+    entries_.push_front({key, generation, documents});
+    index_.emplace(key, entries_.begin());
+    EvictOverCapacity();
+}
+
+QueryCacheStatistics QueryCache::GetStatistics() const {
+    lock_guard guard(mutex_);
+    return statistics_;
+}
+
+void QueryCache::EvictOverCapacity() {
+    while (entries_.size() > capacity_) {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+        ++statistics_.evictions;
+    }
+}
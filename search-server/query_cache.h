@@ -0,0 +1,70 @@
+//
+// -------- Кеш результатов запросов ----------
+//
+
+#ifndef SEARCH_SERVER_QUERY_CACHE_H
+#define SEARCH_SERVER_QUERY_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+
+struct QueryCacheStatistics {
+    size_t hits = 0;
+    size_t misses = 0;
+    // Вытеснено из-за нехватки места; устаревшие записи сюда не входят
+    size_t evictions = 0;
+};
+
+// Потокобезопасный LRU-кеш выдачи на capacity записей. Запись помнит поколение индекса,
+// для которого посчитана: запись другого поколения считается промахом и удаляется.
+//
+// Копия кеша получает ту же вместимость, но пустая: копия сервера дальше меняется отдельно.
+class QueryCache {
+public:
+    explicit QueryCache(size_t capacity = 0);
+
+    QueryCache(const QueryCache &other);
+
+    QueryCache &operator=(const QueryCache &other);
+
+    // 0 - кеш выключен
+    void SetCapacity(size_t capacity);
+
+    [[nodiscard]] bool IsEnabled() const;
+
+    std::optional<std::vector<Document>> Find(const std::string &key, uint64_t generation);
+
+    // Копирует найденную выдачу в documents, переиспользуя его память; false - выдачи нет
+    bool Find(const std::string &key, uint64_t generation, std::vector<Document> &documents);
+
+    void Insert(const std::string &key, uint64_t generation, const std::vector<Document> &documents);
+
+    [[nodiscard]] QueryCacheStatistics GetStatistics() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    // От недавно использованных к давно использованным
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    QueryCacheStatistics statistics_;
+
+    // Вместимость под мьютексом: копирование читает ее у кеша, с которым могут работать другие потоки
+    [[nodiscard]] size_t GetCapacity() const;
+
+    void EvictOverCapacity();
+};
+
+#endif //SEARCH_SERVER_QUERY_CACHE_H
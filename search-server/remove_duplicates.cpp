@@ -4,26 +4,206 @@
 
 #include "remove_duplicates.h"
 
+#include <execution>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
 using namespace std;
 
-void RemoveDuplicates(SearchServer &search_server, bool print_info = true) {
-    auto docs = search_server.GetDocuments();
-    set<set<string_view>> uniq_contents;
-    for (const auto &[id, doc]: search_server.GetDocuments()) {
-        set<string_view> uniq_words;
-        transform(doc.freqs.begin(), doc.freqs.end(),
-                  inserter(uniq_words, uniq_words.begin()),
-                  [](const auto p) {
-                      return p.first;
-                  });
-        if (uniq_contents.count(uniq_words) == 0) {
-            uniq_contents.insert(uniq_words);
+using DocumentTerms = vector<pair<TermId, double>>;
+
+static const size_t NO_DOCUMENT = numeric_limits<size_t>::max();
+
+// Перемешивание битов splitmix64: у соседних значений получаются независимые хеши
+static uint64_t MixBits(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// 128-битный отпечаток множества слов. Суммы хешей слов не зависят от их порядка.
+struct DocumentFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const DocumentFingerprint &other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+struct DocumentFingerprintHasher {
+    size_t operator()(const DocumentFingerprint &fingerprint) const {
+        return static_cast<size_t>(fingerprint.low);
+    }
+};
+
+static DocumentFingerprint ComputeFingerprint(const DocumentTerms &terms) {
+    DocumentFingerprint fingerprint;
+    for (const auto &[term, term_freq]: terms) {
+        const uint64_t hash = MixBits(term);
+        fingerprint.low += hash;
+        fingerprint.high += MixBits(hash);
+    }
+    return fingerprint;
+}
+
+static bool HaveSameTerms(const DocumentTerms &lhs, const DocumentTerms &rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const auto &lhs_term, const auto &rhs_term) {
+        return lhs_term.first == rhs_term.first;
+    });
+}
+
+// Слова документов отсортированы по TermId, поэтому пересечение считается слиянием
+static double ComputeJaccard(const DocumentTerms &lhs, const DocumentTerms &rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t intersection = 0;
+    auto lhs_term = lhs.begin();
+    auto rhs_term = rhs.begin();
+    while (lhs_term != lhs.end() && rhs_term != rhs.end()) {
+        if (lhs_term->first < rhs_term->first) {
+            ++lhs_term;
+        } else if (rhs_term->first < lhs_term->first) {
+            ++rhs_term;
+        } else {
+            ++intersection;
+            ++lhs_term;
+            ++rhs_term;
+        }
+    }
+    return static_cast<double>(intersection) / static_cast<double>(lhs.size() + rhs.size() - intersection);
+}
+
+static vector<int> FindExactDuplicates(TaskScheduler &task_scheduler, const vector<int> &ids,
+                                       const vector<const DocumentTerms *> &terms) {
+    vector<DocumentFingerprint> fingerprints(ids.size());
+    task_scheduler.ParallelFor(terms.size(), [&](size_t i) {
+        fingerprints[i] = ComputeFingerprint(*terms[i]);
+    });
+
+    // Для отпечатка - последний оставленный документ с ним, а оставленные документы с одним отпечатком
+    // связаны в список через previous_kept. Список длиннее одного только при коллизии отпечатков.
+    unordered_map<DocumentFingerprint, size_t, DocumentFingerprintHasher> last_kept;
+    last_kept.reserve(ids.size());
+    vector<size_t> previous_kept(ids.size(), NO_DOCUMENT);
+    vector<int> duplicate_ids;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const auto [it, inserted] = last_kept.emplace(fingerprints[i], i);
+        if (inserted) {
+            continue;
+        }
+        bool is_duplicate = false;
+        for (size_t kept = it->second; kept != NO_DOCUMENT && !is_duplicate; kept = previous_kept[kept]) {
+            is_duplicate = HaveSameTerms(*terms[i], *terms[kept]);
+        }
+        if (is_duplicate) {
+            duplicate_ids.push_back(ids[i]);
         } else {
-            if (print_info) {
-                cout << "Found duplicate document id " << id << endl;
+            previous_kept[i] = it->second;
+            it->second = i;
+        }
+    }
+    return duplicate_ids;
+}
+
+static vector<int> FindNearDuplicates(TaskScheduler &task_scheduler, const vector<int> &ids,
+                                      const vector<const DocumentTerms *> &terms,
+                                      const DuplicateSearchOptions &options) {
+    const size_t band_count = options.band_count;
+    const size_t band_size = options.minhash_count / band_count;
+
+    // Ключ полосы - хеш ее band_size значений MinHash; сигнатура целиком не хранится
+    vector<uint64_t> band_keys(ids.size() * band_count);
+    task_scheduler.ParallelFor(ids.size(), [&](size_t i) {
+        for (size_t band = 0; band < band_count; ++band) {
+            uint64_t key = MixBits(band);
+            for (size_t row = band * band_size; row < (band + 1) * band_size; ++row) {
+                const uint64_t seed = MixBits(row + 1);
+                uint64_t min_hash = numeric_limits<uint64_t>::max();
+                for (const auto &[term, term_freq]: *terms[i]) {
+                    min_hash = min(min_hash, MixBits(term ^ seed));
+                }
+                key = MixBits(key ^ min_hash);
+            }
+            band_keys[i * band_count + band] = key;
+        }
+    });
+
+    // Как в FindExactDuplicates, но у оставленного документа по звену списка на каждую полосу.
+    // Кандидат, найденный в нескольких полосах, сравнивается один раз: last_checked хранит,
+    // для какого документа он уже сравнивался.
+    unordered_map<uint64_t, size_t> last_kept;
+    last_kept.reserve(ids.size() * band_count);
+    vector<size_t> previous_kept(ids.size() * band_count, NO_DOCUMENT);
+    vector<size_t> last_checked(ids.size(), NO_DOCUMENT);
+    vector<int> duplicate_ids;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        bool is_duplicate = false;
+        for (size_t band = 0; band < band_count && !is_duplicate; ++band) {
+            const auto it = last_kept.find(band_keys[i * band_count + band]);
+            if (it == last_kept.end()) {
+                continue;
+            }
+            for (size_t kept = it->second; kept != NO_DOCUMENT && !is_duplicate;
+                 kept = previous_kept[kept * band_count + band]) {
+                if (last_checked[kept] != i) {
+                    last_checked[kept] = i;
+                    is_duplicate = ComputeJaccard(*terms[i], *terms[kept]) >= options.jaccard_threshold;
+                }
+            }
+        }
+        if (is_duplicate) {
+            duplicate_ids.push_back(ids[i]);
+            continue;
+        }
+        for (size_t band = 0; band < band_count; ++band) {
+            const auto [it, inserted] = last_kept.emplace(band_keys[i * band_count + band], i);
+            if (!inserted) {
+                previous_kept[i * band_count + band] = it->second;
+                it->second = i;
             }
-            search_server.RemoveDocument(id);
-            docs.erase(id);
         }
     }
-}
\ No newline at end of file
+    return duplicate_ids;
+}
+
+vector<int> FindDuplicates(const SearchServer &search_server, const DuplicateSearchOptions &options) {
+    if (!(options.jaccard_threshold > 0.0 && options.jaccard_threshold <= 1.0)) {
+        throw invalid_argument("Jaccard threshold must be in (0, 1]");
+    }
+    if (options.minhash_count == 0 || options.band_count == 0 || options.minhash_count % options.band_count != 0) {
+        throw invalid_argument("MinHash count must be a positive multiple of band count");
+    }
+
+    // Документы идут по возрастанию id, поэтому из каждой группы остается документ с меньшим id
+    const vector<int> ids(search_server.begin(), search_server.end());
+    TaskScheduler &task_scheduler = search_server.GetTaskScheduler();
+    vector<const DocumentTerms *> terms(ids.size());
+    task_scheduler.ParallelFor(ids.size(), [&](size_t i) {
+        terms[i] = &search_server.GetDocumentTerms(ids[i]);
+    });
+
+    if (options.jaccard_threshold == 1.0) {
+        return FindExactDuplicates(task_scheduler, ids, terms);
+    }
+    return FindNearDuplicates(task_scheduler, ids, terms, options);
+}
+
+vector<int> RemoveDuplicates(SearchServer &search_server, bool print_info) {
+    return RemoveDuplicates(search_server, {}, print_info);
+}
+
+vector<int> RemoveDuplicates(SearchServer &search_server, const DuplicateSearchOptions &options, bool print_info) {
+    const vector<int> duplicate_ids = FindDuplicates(search_server, options);
+    if (print_info) {
+        for (const int id: duplicate_ids) {
+            cout << "Found duplicate document id " << id << endl;
+        }
+    }
+    // Удаление после поиска: иначе поиск шел бы по изменяемому контейнеру документов
+    search_server.RemoveDocuments(execution::par, duplicate_ids);
+    return duplicate_ids;
+}
@@ -6,8 +6,28 @@
 #define SEARCH_SERVER_REMOVE_DUPLICATES_H
 
 #include <iostream>
+#include <vector>
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer &search_server, bool print_info);
+struct DuplicateSearchOptions {
+    // Документ - дубликат, если мера Жаккара его множества слов и множества слов документа
+    // с меньшим id не меньше порога. При 1 ищутся совпадающие множества слов по их отпечаткам,
+    // при меньшем пороге - почти дубликаты по MinHash.
+    double jaccard_threshold = 1.0;
+    // Длина сигнатуры MinHash и число полос LSH, на которые она делится поровну. Пара с мерой
+    // Жаккара s сравнивается точно с вероятностью 1 - (1 - s^r)^band_count, r = minhash_count / band_count.
+    size_t minhash_count = 128;
+    size_t band_count = 32;
+};
+
+// Возвращает id дубликатов по возрастанию, из каждой группы остается документ с меньшим id.
+// Индекс не копируется, отпечатки и сигнатуры документов считаются параллельно.
+std::vector<int> FindDuplicates(const SearchServer &search_server, const DuplicateSearchOptions &options = {});
+
+// Удаляет дубликаты одной пачкой (см. SearchServer::RemoveDocuments) и возвращает их id
+std::vector<int> RemoveDuplicates(SearchServer &search_server, bool print_info = true);
+
+std::vector<int> RemoveDuplicates(SearchServer &search_server, const DuplicateSearchOptions &options,
+                                  bool print_info = true);
 
 #endif //SEARCH_SERVER_REMOVE_DUPLICATES_H
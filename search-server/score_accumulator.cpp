@@ -0,0 +1,39 @@
+//
+// -------- Накопление релевантности ----------
+//
+
+#include "score_accumulator.h"
+
+#include <algorithm>
+
+using namespace std;
+
+template<typename Score>
+void BasicScoreAccumulator<Score>::Reset(size_t slot_count) {
+    if (generations_.size() < slot_count) {
+        generations_.resize(slot_count, EMPTY_GENERATION);
+        scores_.resize(slot_count);
+    }
+    touched_slots_.clear();
+    if (++generation_ == EMPTY_GENERATION) {
+        fill(generations_.begin(), generations_.end(), EMPTY_GENERATION);
+        ++generation_;
+    }
+}
+
+template<typename Score>
+void BasicScoreAccumulator<Score>::Merge(const BasicScoreAccumulator &other) {
+    other.ForEach([this](DocumentSlot slot, Score score) {
+        Add(slot, score);
+    });
+}
+
+template<typename Score>
+BasicScratchScoreAccumulator<Score>::BasicScratchScoreAccumulator(size_t slot_count) {
+    accumulator_->Reset(slot_count);
+}
+
+template class BasicScoreAccumulator<double>;
+template class BasicScoreAccumulator<uint32_t>;
+template class BasicScratchScoreAccumulator<double>;
+template class BasicScratchScoreAccumulator<uint32_t>;
@@ -0,0 +1,101 @@
+//
+// -------- Накопление релевантности ----------
+//
+
+#ifndef SEARCH_SERVER_SCORE_ACCUMULATOR_H
+#define SEARCH_SERVER_SCORE_ACCUMULATOR_H
+
+#include <cstdint>
+#include <vector>
+#include "posting_list.h"
+#include "scratch_object.h"
+
+// Релевантность документов хранится в плоском массиве по номерам слотов документов.
+// Вместо очистки массива между запросами увеличивается номер поколения: слот считается
+// заполненным, только если его поколение совпадает с текущим.
+// Score - double для точной релевантности и целое для квантованных импактов (см. ImpactIndex).
+template<typename Score>
+class BasicScoreAccumulator {
+public:
+    // Начинает новый запрос по slot_count слотам
+    void Reset(size_t slot_count);
+
+    void Add(DocumentSlot slot, Score score) {
+        if (generations_[slot] != generation_) {
+            generations_[slot] = generation_;
+            scores_[slot] = score;
+            touched_slots_.push_back(slot);
+        } else {
+            scores_[slot] += score;
+        }
+    }
+
+    // Добавляет score, только если слот уже заполнен
+    void AddIfPresent(DocumentSlot slot, Score score) {
+        if (generations_[slot] == generation_) {
+            scores_[slot] += score;
+        }
+    }
+
+    [[nodiscard]] bool Contains(DocumentSlot slot) const {
+        return generations_[slot] == generation_;
+    }
+
+    // Накопленное для слота, 0 - если слот не заполнен
+    [[nodiscard]] Score Get(DocumentSlot slot) const {
+        return Contains(slot) ? scores_[slot] : Score();
+    }
+
+    void Erase(DocumentSlot slot) {
+        generations_[slot] = EMPTY_GENERATION;
+    }
+
+    // Добавляет к себе все накопленное в other
+    void Merge(const BasicScoreAccumulator &other);
+
+    template<typename Function>
+    void ForEach(Function function) const {
+        for (const DocumentSlot slot: touched_slots_) {
+            if (generations_[slot] == generation_) {
+                function(slot, scores_[slot]);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t EMPTY_GENERATION = 0;
+
+    uint32_t generation_ = EMPTY_GENERATION;
+    std::vector<uint32_t> generations_;
+    std::vector<Score> scores_;
+    std::vector<DocumentSlot> touched_slots_;
+};
+
+using ScoreAccumulator = BasicScoreAccumulator<double>;
+
+using ImpactScoreAccumulator = BasicScoreAccumulator<uint32_t>;
+
+// Аккумулятор из пула текущего потока (см. ScratchObject), готовый к новому запросу
+template<typename Score>
+class BasicScratchScoreAccumulator {
+public:
+    explicit BasicScratchScoreAccumulator(size_t slot_count);
+
+    BasicScoreAccumulator<Score> &operator*() { return *accumulator_; }
+
+    BasicScoreAccumulator<Score> *operator->() { return &*accumulator_; }
+
+private:
+    ScratchObject<BasicScoreAccumulator<Score>> accumulator_;
+};
+
+using ScratchScoreAccumulator = BasicScratchScoreAccumulator<double>;
+
+using ScratchImpactScoreAccumulator = BasicScratchScoreAccumulator<uint32_t>;
+
+extern template class BasicScoreAccumulator<double>;
+extern template class BasicScoreAccumulator<uint32_t>;
+extern template class BasicScratchScoreAccumulator<double>;
+extern template class BasicScratchScoreAccumulator<uint32_t>;
+
+#endif //SEARCH_SERVER_SCORE_ACCUMULATOR_H
@@ -0,0 +1,48 @@
+//
+// -------- Объекты из пула потока ----------
+//
+
+#ifndef SEARCH_SERVER_SCRATCH_OBJECT_H
+#define SEARCH_SERVER_SCRATCH_OBJECT_H
+
+#include <memory>
+#include <vector>
+
+// Объект из пула текущего потока. Объект возвращается в пул вместе с выделенной им памятью,
+// поэтому повторные запросы в потоке не выделяют память заново, а вложенные запросы
+// в одном потоке получают разные объекты. Состояние объекта не сбрасывается.
+template<typename T>
+class ScratchObject {
+public:
+    ScratchObject() {
+        auto &pool = GetPool();
+        if (pool.empty()) {
+            object_ = std::make_unique<T>();
+        } else {
+            object_ = std::move(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    ScratchObject(const ScratchObject &) = delete;
+
+    ScratchObject &operator=(const ScratchObject &) = delete;
+
+    ~ScratchObject() {
+        GetPool().push_back(std::move(object_));
+    }
+
+    T &operator*() { return *object_; }
+
+    T *operator->() { return object_.get(); }
+
+private:
+    std::unique_ptr<T> object_;
+
+    static std::vector<std::unique_ptr<T>> &GetPool() {
+        static thread_local std::vector<std::unique_ptr<T>> pool;
+        return pool;
+    }
+};
+
+#endif //SEARCH_SERVER_SCRATCH_OBJECT_H
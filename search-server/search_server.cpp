@@ -3,9 +3,18 @@
 //
 
 #include "search_server.h"
+#include "index_snapshot.h"
+
+#include <unordered_map>
 
 using namespace std;
 
+// Во сколько раз проверка вхождения поиском галопом дороже чтения вхождения при сборке битовой карты
+static const size_t GALLOP_SEEK_COST = 100;
+
+// Меньше вхождений на отрезок id при параллельном поиске не окупают свой аккумулятор и отбор лучших
+static const size_t MIN_RANGE_POSTING_COUNT = 4096;
+
 // STATIC METHODS
 
 static int ComputeAverageRating(const vector<int> &ratings) {
@@ -27,6 +36,7 @@ SearchServer::SearchServer(std::string_view stop_words) : SearchServer(SplitInto
 // SET STOP WORDS
 
 void SearchServer::SetStopWords(string_view stop_words) {
+    ++generation_;
     stop_words_ = MakeUniqueNonEmptyStrings(SplitIntoWords(stop_words));
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Stop words should not contain special characters.");
@@ -38,23 +48,194 @@ void SearchServer::SetStopWords(string_view stop_words) {
 void
 SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int> &ratings) {
     if (document_id < 0) throw invalid_argument("Document ID must be a natural number.");
-    if (documents_.count(document_id) > 0) throw invalid_argument("Document with this ID already exists.");
+    if (document_slots_.count(document_id) > 0) throw invalid_argument("Document with this ID already exists.");
 
-    document_ids_.insert(document_id);
-    documents_.emplace(document_id, DocumentData());
+    // Слова копируются в словарь, поэтому разбирать можно исходный текст.
+    // Разбор идет до изменений: документ с некорректным словом не оставляет следов в индексе
+    const auto words = SplitIntoWordsNoStop(document);
 
-    dictionary_.emplace_back(document);
-
-    const auto words = SplitIntoWordsNoStop(dictionary_.back());
+    ++generation_;
+    const DocumentSlot slot = AcquireSlot(document_id, status, ComputeAverageRating(ratings));
+    DocumentData &data = documents_[slot];
+    data.text_id = document_texts_.Store(document);
     const double inv_word_count = 1 / static_cast<double>(words.size());
 
+    vector<TermId> term_ids;
+    term_ids.reserve(words.size());
     for (const auto &word: words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        documents_[document_id].freqs[word] += inv_word_count;
+        term_ids.push_back(terms_.Intern(word));
+    }
+    sort(term_ids.begin(), term_ids.end());
+    word_to_document_freqs_.resize(terms_.size());
+
+    data.word_count = static_cast<uint32_t>(words.size());
+    auto &freqs = data.freqs;
+    for (auto it = term_ids.begin(); it != term_ids.end();) {
+        const auto range_end = upper_bound(it, term_ids.end(), *it);
+        const double term_freq = static_cast<double>(range_end - it) * inv_word_count;
+        freqs.emplace_back(*it, term_freq);
+        word_to_document_freqs_[*it].Insert(document_id, slot, term_freq);
+        it = range_end;
+    }
+
+    IndexImpactScores(slot);
+    RefreshImpactScores();
+}
+
+void SearchServer::AddDocuments(const vector<DocumentToAdd> &documents) {
+    AddDocuments(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const execution::sequenced_policy &policy, const vector<DocumentToAdd> &documents) {
+    AddDocumentsImpl(policy, documents, 1);
+}
+
+void SearchServer::AddDocuments(const execution::parallel_policy &policy, const vector<DocumentToAdd> &documents) {
+    // Частей больше, чем потоков, чтобы длинные документы не задерживали одну из них
+    const size_t part_count = 4 * task_scheduler_->GetThreadCount();
+    AddDocumentsImpl(policy, documents, min(part_count, max(documents.size(), size_t(1))));
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::AddDocumentsImpl(const ExecutionPolicy &policy, const vector<DocumentToAdd> &documents,
+                                    size_t part_count) {
+    // Проверки id - в том же порядке, что в AddDocument
+    vector<exception_ptr> errors(documents.size());
+    set<int> batch_ids;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const int document_id = documents[i].document_id;
+        if (document_id < 0) {
+            errors[i] = make_exception_ptr(invalid_argument("Document ID must be a natural number."));
+        } else if (document_slots_.count(document_id) > 0 || !batch_ids.insert(document_id).second) {
+            errors[i] = make_exception_ptr(invalid_argument("Document with this ID already exists."));
+        }
+    }
+
+    vector<size_t> part_bounds(part_count + 1);
+    for (size_t part = 0; part <= part_count; ++part) {
+        part_bounds[part] = documents.size() * part / part_count;
+    }
+    vector<PartialIndex> parts(part_count);
+    ForEachIndex(policy, part_count, [&](size_t part) {
+        parts[part] = BuildPartialIndex(documents, part_bounds[part], part_bounds[part + 1], errors);
+    });
+    for (const auto &error: errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    ++generation_;
+    // Словарь и метаданные документов общие, поэтому заполняются последовательно
+    vector<vector<TermId>> part_term_ids(part_count);
+    for (size_t part = 0; part < part_count; ++part) {
+        part_term_ids[part].reserve(parts[part].words.size());
+        for (const string_view word: parts[part].words) {
+            part_term_ids[part].push_back(terms_.Intern(word));
+        }
+    }
+    word_to_document_freqs_.resize(terms_.size());
+
+    // Все слоты заняты до параллельной части, поэтому столбцы в ней не перевыделяются
+    vector<DocumentSlot> added(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const auto &document = documents[i];
+        added[i] = AcquireSlot(document.document_id, document.status, ComputeAverageRating(document.ratings));
+        documents_[added[i]].text_id = document_texts_.Store(document.document);
+    }
+
+    // Вхождения собираются по частям, затем группируются по словам, и каждое слово
+    // дописывается в свой список независимо от остальных
+    vector<vector<pair<TermId, Posting>>> part_postings(part_count);
+    ForEachIndex(policy, part_count, [&](size_t part) {
+        const auto &term_ids = part_term_ids[part];
+        auto &postings = part_postings[part];
+        for (size_t i = part_bounds[part]; i < part_bounds[part + 1]; ++i) {
+            const size_t local_index = i - part_bounds[part];
+            DocumentData &data = documents_[added[i]];
+            data.word_count = parts[part].word_counts[local_index];
+            data.freqs.reserve(parts[part].document_words[local_index].size());
+            for (const auto &[word, term_freq]: parts[part].document_words[local_index]) {
+                data.freqs.emplace_back(term_ids[word], term_freq);
+                postings.emplace_back(term_ids[word], Posting{documents[i].document_id, added[i], term_freq});
+            }
+            sort(data.freqs.begin(), data.freqs.end());
+        }
+    });
+    // Сортировка подсчетом по словам; внутри слова вхождения остаются в порядке пачки
+    vector<size_t> term_offsets(terms_.size() + 1, 0);
+    for (const auto &part: part_postings) {
+        for (const auto &[word, posting]: part) {
+            ++term_offsets[word + 1];
+        }
+    }
+    partial_sum(term_offsets.begin(), term_offsets.end(), term_offsets.begin());
+    vector<Posting> postings(term_offsets.back());
+    {
+        vector<size_t> positions(term_offsets.begin(), term_offsets.end() - 1);
+        for (auto &part: part_postings) {
+            for (const auto &[word, posting]: part) {
+                postings[positions[word]++] = posting;
+            }
+            vector<pair<TermId, Posting>>().swap(part);
+        }
+    }
+    vector<TermId> words;
+    for (TermId word = 0; word < terms_.size(); ++word) {
+        if (term_offsets[word] != term_offsets[word + 1]) {
+            words.push_back(word);
+        }
+    }
+    ForEachIndex(policy, words.size(), [&](size_t i) {
+        const TermId word = words[i];
+        Posting *const first = postings.data() + term_offsets[word];
+        Posting *const last = postings.data() + term_offsets[word + 1];
+        const auto by_id = [](const Posting &lhs, const Posting &rhs) { return lhs.document_id < rhs.document_id; };
+        if (!is_sorted(first, last, by_id)) {
+            sort(first, last, by_id);
+        }
+        word_to_document_freqs_[word].Insert(first, last);
+    });
+    for (const DocumentSlot slot: added) {
+        IndexImpactScores(slot);
     }
+    RefreshImpactScores();
+}
 
-    documents_[document_id].rating = ComputeAverageRating(ratings);
-    documents_[document_id].status = status;
+SearchServer::PartialIndex SearchServer::BuildPartialIndex(const vector<DocumentToAdd> &documents, size_t first,
+                                                           size_t last, vector<exception_ptr> &errors) const {
+    PartialIndex index;
+    unordered_map<string_view, uint32_t> word_numbers;
+    for (size_t i = first; i < last; ++i) {
+        vector<string_view> words;
+        if (!errors[i]) {
+            try {
+                words = SplitIntoWordsNoStop(documents[i].document);
+            } catch (...) {
+                errors[i] = current_exception();
+            }
+        }
+        vector<uint32_t> numbers;
+        numbers.reserve(words.size());
+        for (const string_view word: words) {
+            const auto [it, inserted] = word_numbers.emplace(word, static_cast<uint32_t>(index.words.size()));
+            if (inserted) {
+                index.words.push_back(word);
+            }
+            numbers.push_back(it->second);
+        }
+        sort(numbers.begin(), numbers.end());
+
+        const double inv_word_count = 1 / static_cast<double>(words.size());
+        auto &document_words = index.document_words.emplace_back();
+        for (auto it = numbers.begin(); it != numbers.end();) {
+            const auto range_end = upper_bound(it, numbers.end(), *it);
+            document_words.emplace_back(*it, static_cast<double>(range_end - it) * inv_word_count);
+            it = range_end;
+        }
+        index.word_counts.push_back(static_cast<uint32_t>(words.size()));
+    }
+    return index;
 }
 
 void AddDocument(SearchServer &search_server, int document_id, string_view document, DocumentStatus status,
@@ -69,48 +250,88 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy &policy, int document_id) {
-    if (document_ids_.count(document_id) == 0) return;
-    for (auto &[key, val]: word_to_document_freqs_) {
-        val.erase(document_id);
+    if (document_slots_.count(document_id) == 0) return;
+    for (const auto &[word, term_freq]: documents_[GetSlot(document_id)].freqs) {
+        word_to_document_freqs_[word].Erase(document_id);
+        ReleaseTermIfUnused(word);
     }
-    document_ids_.erase(document_id);
-    documents_.erase(document_id);
+    EraseDocumentData(document_id);
+    RefreshImpactScores();
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy &policy, int document_id) {
-    if (document_ids_.count(document_id) == 0) return;
-    const auto &freqs = documents_.at(document_id).freqs;
-    std::vector<string_view> words(freqs.size());
-    std::transform(policy,
-                   freqs.begin(), freqs.end(),
-                   words.begin(),
-                   [](const auto &word) {
-                       return word.first;
-                   }
-    );
-    std::for_each(policy,
-                  words.begin(), words.end(),
-                  [&, document_id](const auto &word) {
-                      word_to_document_freqs_[word].erase(document_id);
-                  }
-    );
-    document_ids_.erase(document_id);
-    documents_.erase(document_id);
+    if (document_slots_.count(document_id) == 0) return;
+    const auto &freqs = documents_[GetSlot(document_id)].freqs;
+    // У каждого слова свой список вхождений, поэтому потоки не пересекаются
+    ForEachIndex(policy, freqs.size(), [&](size_t i) {
+        word_to_document_freqs_[freqs[i].first].Erase(document_id);
+    });
+    // Словарь общий для всех слов, поэтому освобождение слов - последовательно
+    for (const auto &[word, term_freq]: freqs) {
+        ReleaseTermIfUnused(word);
+    }
+    EraseDocumentData(document_id);
+    RefreshImpactScores();
+}
+
+void SearchServer::RemoveDocuments(const vector<int> &document_ids) {
+    RemoveDocuments(execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const execution::sequenced_policy &policy, const vector<int> &document_ids) {
+    const auto term_documents = GroupDocumentsByTerm(document_ids);
+    for (const auto &[word, ids]: term_documents) {
+        word_to_document_freqs_[word].Erase(ids);
+        ReleaseTermIfUnused(word);
+    }
+    for (const int document_id: document_ids) {
+        if (document_slots_.count(document_id) > 0) {
+            EraseDocumentData(document_id);
+        }
+    }
+    RefreshImpactScores();
+}
+
+void SearchServer::RemoveDocuments(const execution::parallel_policy &policy, const vector<int> &document_ids) {
+    const auto term_documents = GroupDocumentsByTerm(document_ids);
+    ForEachIndex(policy, term_documents.size(), [&](size_t i) {
+        word_to_document_freqs_[term_documents[i].first].Erase(term_documents[i].second);
+    });
+    for (const auto &[word, ids]: term_documents) {
+        ReleaseTermIfUnused(word);
+    }
+    for (const int document_id: document_ids) {
+        if (document_slots_.count(document_id) > 0) {
+            EraseDocumentData(document_id);
+        }
+    }
+    RefreshImpactScores();
 }
 
 // GET DOCUMENTS
 
 [[nodiscard]] int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    return static_cast<int>(document_slots_.size());
+}
+
+bool SearchServer::HasDocument(int document_id) const {
+    return document_slots_.count(document_id) > 0;
+}
+
+const vector<pair<TermId, double>> &SearchServer::GetDocumentTerms(int document_id) const {
+    return documents_[GetSlot(document_id)].freqs;
 }
 
 // FIND DOCUMENTS
 
 [[nodiscard]] vector<Document>
-SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus doc_status, int rating) {
-        return doc_status == status;
-    });
+SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(execution::seq, raw_query, status, top_k);
+}
+
+[[nodiscard]] vector<Document>
+SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter &filter, size_t top_k) const {
+    return FindTopDocuments(execution::seq, raw_query, filter, top_k);
 }
 
 // MATCH DOCUMENTS
@@ -128,30 +349,25 @@ SearchServer::MatchDocument(const execution::sequenced_policy &policy, string_vi
     SEARCH_SERVER_DURATION;
 #endif
 
-    if (documents_.count(document_id) == 0) throw out_of_range("A nonexistent document_id was passed.");
+    const DocumentStatus status = slot_statuses_[GetSlot(document_id)];
 
     const auto query = ParseQuery(raw_query);
     vector<string_view> matched_words;
 
-    for (const auto &word: query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return {matched_words, documents_.at(document_id).status};
+    for (const TermId word: query.minus_words) {
+        if (word_to_document_freqs_[word].Contains(document_id)) {
+            return {matched_words, status};
         }
     }
 
-    for (const auto &word: query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+    for (const TermId word: query.plus_words) {
+        if (word_to_document_freqs_[word].Contains(document_id)) {
+            matched_words.push_back(terms_.GetTerm(word));
         }
     }
+    sort(matched_words.begin(), matched_words.end());
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, status};
 }
 
 [[nodiscard]] tuple<vector<string_view>, DocumentStatus>
@@ -165,88 +381,75 @@ SearchServer::MatchDocument(const execution::parallel_policy &policy, string_vie
     const auto &query = ParseQuery(raw_query, true);
     vector<string_view> matched_words;
 
-    if (!std::any_of(policy,
-                     query.minus_words.begin(), query.minus_words.end(),
-                     [&](const auto &word) {
-                         return word_to_document_freqs_.count(word) &&
-                                word_to_document_freqs_.at(word).count(document_id);
-                     })) {
-        matched_words.resize(query.plus_words.size());
-        const auto &iter = std::copy_if(policy,
-                                        query.plus_words.begin(), query.plus_words.end(),
-                                        matched_words.begin(),
-                                        [&](const auto &word) {
-                                            return word_to_document_freqs_.count(word) &&
-                                                   word_to_document_freqs_.at(word).count(document_id);
-                                        });
-        matched_words.resize(std::distance(matched_words.begin(), iter));
-        sort(policy, matched_words.begin(), matched_words.end());
-        auto range_end = unique(policy, matched_words.begin(), matched_words.end());
-        matched_words.erase(range_end, matched_words.end());
-    }
-    return {matched_words, documents_.at(document_id).status};
+    // Минус-слова и плюс-слова проверяются одним проходом: флаг на слово, без общих записей
+    const size_t minus_count = query.minus_words.size();
+    vector<char> contains(minus_count + query.plus_words.size());
+    ForEachIndex(policy, contains.size(), [&](size_t i) {
+        const TermId word = i < minus_count ? query.minus_words[i] : query.plus_words[i - minus_count];
+        contains[i] = word_to_document_freqs_[word].Contains(document_id);
+    });
+    if (none_of(contains.begin(), contains.begin() + minus_count, [](char value) { return value != 0; })) {
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            if (contains[minus_count + i]) {
+                matched_words.push_back(terms_.GetTerm(query.plus_words[i]));
+            }
+        }
+        sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    }
+    return {matched_words, slot_statuses_[GetSlot(document_id)]};
 }
 
 // BOOLEAN
 
-bool SearchServer::IsValidWord(string_view word) {
-    // A valid word must not contain special characters
-    return none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-    });
-}
-
 [[nodiscard]] bool SearchServer::IsStopWord(string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
 // QUERY
 
-[[nodiscard]] SearchServer::QueryWord SearchServer::ParseQueryWord(string_view word) const {
-    bool is_minus = false;
-    // Word shouldn't be empty
-    if (word[0] == '-') {
-        is_minus = true;
-        word = word.substr(1);
-    }
-    if (word.empty() || !IsValidWord(word)) {
-        throw invalid_argument("Query has incorrect symbols in " + string(word) + ".");
-    }
-    if (is_minus && word[0] == '-') {
-        throw invalid_argument("Query has incorrect minus-words:" + string(word) + ".");
-    }
-    return {word, is_minus, IsStopWord(word)};
+[[nodiscard]] SearchServer::QueryWord SearchServer::ParseQueryWord(string_view word, bool is_valid_word) const {
+    const auto [data, is_minus] = ParseQueryToken(word, is_valid_word);
+    return {data, is_minus, IsStopWord(data)};
 }
 
 [[nodiscard]] SearchServer::Query SearchServer::ParseQuery(string_view text, bool skip_sort) const {
     Query query;
-    for (const auto word: SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
-            } else {
-                query.plus_words.push_back(query_word.data);
-            }
+    ParseQuery(text, query, skip_sort);
+    return query;
+}
+
+void SearchServer::ParseQuery(string_view text, Query &query, bool skip_sort) const {
+    query.plus_words.clear();
+    query.minus_words.clear();
+    ForEachWord(text, [this, &query](string_view word, bool is_valid_word) {
+        const auto query_word = ParseQueryWord(word, is_valid_word);
+        if (query_word.is_stop) {
+            return;
         }
-    }
+        const TermId term_id = terms_.Find(query_word.data);
+        if (term_id == INVALID_TERM_ID) {
+            return;
+        }
+        if (query_word.is_minus) {
+            query.minus_words.push_back(term_id);
+        } else {
+            query.plus_words.push_back(term_id);
+        }
+    });
     if (!skip_sort) {
         for (auto *words: {&query.plus_words, &query.minus_words}) {
             sort(words->begin(), words->end());
             words->erase(unique(words->begin(), words->end()), words->end());
         }
     }
-    return query;
 }
 
 vector<vector<Document>> ProcessQueries(const SearchServer &search_server, const vector<string> &queries) {
     vector<vector<Document>> documents_lists(queries.size());
-    transform(execution::par,
-              queries.begin(), queries.end(),
-              documents_lists.begin(),
-              [&search_server](const auto &query) {
-                  return search_server.FindTopDocuments(query);
-              });
+    search_server.GetTaskScheduler().ParallelFor(queries.size(), [&](size_t i) {
+        documents_lists[i] = search_server.FindTopDocuments(queries[i]);
+    });
     return documents_lists;
 }
 
@@ -268,26 +471,405 @@ set<int>::iterator SearchServer::end() {
     return std::end(document_ids_);
 }
 
+set<int>::const_iterator SearchServer::begin() const {
+    return std::begin(document_ids_);
+}
+
+set<int>::const_iterator SearchServer::end() const {
+    return std::end(document_ids_);
+}
+
 // TOOLS
 
+DocumentSlot SearchServer::AcquireSlot(int document_id, DocumentStatus status, int rating) {
+    DocumentSlot slot;
+    if (free_slots_.empty()) {
+        slot = static_cast<DocumentSlot>(slot_documents_.size());
+        documents_.emplace_back();
+        slot_documents_.push_back(document_id);
+        slot_statuses_.push_back(status);
+        slot_ratings_.push_back(rating);
+    } else {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        slot_documents_[slot] = document_id;
+        slot_statuses_[slot] = status;
+        slot_ratings_[slot] = rating;
+    }
+    document_slots_.emplace(document_id, slot);
+    document_ids_.insert(document_id);
+    live_documents_.Set(slot);
+    const auto status_index = static_cast<size_t>(status);
+    if (status_index >= status_documents_.size()) {
+        status_documents_.resize(status_index + 1);
+    }
+    status_documents_[status_index].Set(slot);
+    return slot;
+}
+
+DocumentSlot SearchServer::GetSlot(int document_id) const {
+    const auto it = document_slots_.find(document_id);
+    if (it == document_slots_.end()) {
+        throw out_of_range("A nonexistent document_id was passed.");
+    }
+    return it->second;
+}
+
+void SearchServer::ReleaseSlot(DocumentSlot slot) {
+    document_slots_.erase(slot_documents_[slot]);
+    document_ids_.erase(slot_documents_[slot]);
+    // Слова и частоты освобождаются сразу, а не при повторном занятии слота
+    documents_[slot] = DocumentData();
+    slot_documents_[slot] = -1;
+    live_documents_.Reset(slot);
+    status_documents_[static_cast<size_t>(slot_statuses_[slot])].Reset(slot);
+    free_slots_.push_back(slot);
+}
+
+SearchServer::SlotFilter SearchServer::MakeSlotFilter(const DocumentFilter &filter) const {
+    static const DocumentBitmap empty;
+    if (!filter.status) {
+        return {&live_documents_, filter.min_rating, filter.max_rating};
+    }
+    const auto status_index = static_cast<size_t>(*filter.status);
+    return {status_index < status_documents_.size() ? &status_documents_[status_index] : &empty,
+            filter.min_rating, filter.max_rating};
+}
+
+void SearchServer::ReleaseTermIfUnused(TermId word) {
+    if (word_to_document_freqs_[word].empty()) {
+        terms_.Erase(word);
+        word_to_document_freqs_[word] = PostingList();
+    }
+}
+
+vector<pair<TermId, vector<int>>> SearchServer::GroupDocumentsByTerm(const vector<int> &document_ids) const {
+    vector<pair<TermId, int>> term_documents;
+    for (const int document_id: document_ids) {
+        const auto it = document_slots_.find(document_id);
+        if (it == document_slots_.end()) {
+            continue;
+        }
+        for (const auto &[word, term_freq]: documents_[it->second].freqs) {
+            term_documents.emplace_back(word, document_id);
+        }
+    }
+    sort(term_documents.begin(), term_documents.end());
+    term_documents.erase(unique(term_documents.begin(), term_documents.end()), term_documents.end());
+
+    vector<pair<TermId, vector<int>>> groups;
+    for (const auto &[word, document_id]: term_documents) {
+        if (groups.empty() || groups.back().first != word) {
+            groups.emplace_back(word, vector<int>());
+        }
+        groups.back().second.push_back(document_id);
+    }
+    return groups;
+}
+
+void SearchServer::EraseDocumentData(int document_id) {
+    ++generation_;
+    const DocumentSlot slot = GetSlot(document_id);
+    const DocumentData &document = documents_[slot];
+    if (impact_index_.IsEnabled()) {
+        for (const auto &[word, term_freq]: document.freqs) {
+            impact_index_.Erase(word, slot, term_freq);
+        }
+    }
+    document_texts_.Release(document.text_id);
+    ReleaseSlot(slot);
+}
+
+const DocumentBitmap *SearchServer::CollectExcludedDocuments(const Query &query, DocumentBitmap &excluded) const {
+    if (query.minus_words.empty()) {
+        return nullptr;
+    }
+    // У частого слова 64-битных слов в карте не больше, чем вхождений: объединение с картой из кеша
+    // не дороже обхода списка, а кеш занимает не больше 8 байт на вхождение
+    const size_t bitmap_size = slot_documents_.size() / 64 + 1;
+    const auto is_frequent = [bitmap_size](const PostingList &postings) {
+        return postings.size() >= bitmap_size;
+    };
+
+    size_t plus_posting_count = 0;
+    size_t minus_cost = 0;
+    for (const TermId word: query.plus_words) {
+        plus_posting_count += word_to_document_freqs_[word].size();
+    }
+    for (const TermId word: query.minus_words) {
+        const PostingList &postings = word_to_document_freqs_[word];
+        minus_cost += is_frequent(postings) ? bitmap_size : postings.size();
+    }
+    // Поиск галопом - несколько промахов кеша на вхождение плюс-слова и минус-слово,
+    // сборка карты - последовательное чтение
+    if (minus_cost > plus_posting_count * query.minus_words.size() * GALLOP_SEEK_COST) {
+        return nullptr;
+    }
+
+    const auto set_slots = [](const PostingList &postings, DocumentBitmap &bitmap) {
+        for (PostingList::Cursor cursor(postings); !cursor.IsEnd(); cursor.NextBlock()) {
+            bitmap.Set(cursor.BlockBegin(), cursor.BlockEnd());
+        }
+    };
+    excluded.Clear();
+    for (const TermId word: query.minus_words) {
+        const PostingList &postings = word_to_document_freqs_[word];
+        if (!is_frequent(postings)) {
+            set_slots(postings, excluded);
+            continue;
+        }
+        auto word_bitmap = minus_word_bitmaps_.Find(word, generation_);
+        if (word_bitmap == nullptr) {
+            auto bitmap = make_shared<DocumentBitmap>();
+            set_slots(postings, *bitmap);
+            word_bitmap = bitmap;
+            minus_word_bitmaps_.Insert(word, generation_, word_bitmap);
+        }
+        excluded.Merge(*word_bitmap);
+    }
+    return &excluded;
+}
+
+void SearchServer::CollectTopDocuments(const ScoreAccumulator &document_to_relevance,
+                                       TopDocuments &top_documents) const {
+    document_to_relevance.ForEach([&](DocumentSlot slot, double relevance) {
+        top_documents.Add(Document(slot_documents_[slot], relevance, slot_ratings_[slot]));
+    });
+}
 
-[[nodiscard]] double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() / static_cast<double>(word_to_document_freqs_.at(word).size()));
+void SearchServer::CompressPostings() {
+    for (auto &postings: word_to_document_freqs_) {
+        postings.Compress([this](int document_id) {
+            return documents_[GetSlot(document_id)].word_count;
+        });
+    }
+}
+
+PostingsMemoryUsage SearchServer::GetPostingsMemoryUsage() const {
+    PostingsMemoryUsage usage;
+    for (const auto &postings: word_to_document_freqs_) {
+        usage += postings.GetMemoryUsage();
+    }
+    return usage;
+}
+
+void SearchServer::EnableImpactScores(ImpactScoreOptions options) {
+    ++generation_;
+    impact_index_.Rebuild(options, word_to_document_freqs_, [this](TermId word) {
+        return ComputeWordInverseDocumentFreq(word);
+    }, GetDocumentCount());
+}
+
+void SearchServer::DisableImpactScores() {
+    ++generation_;
+    impact_index_.Clear();
+}
+
+double SearchServer::GetImpactScoreError() const {
+    return impact_index_.IsEnabled() ? impact_index_.GetMaxError() : 0;
+}
+
+void SearchServer::IndexImpactScores(DocumentSlot slot) {
+    if (!impact_index_.IsEnabled() || impact_index_.IsStale(GetDocumentCount())) {
+        // Устаревший индекс все равно будет пересчитан целиком
+        return;
+    }
+    for (const auto &[word, term_freq]: documents_[slot].freqs) {
+        impact_index_.Insert(word, slot, term_freq, ComputeWordInverseDocumentFreq(word));
+    }
+}
+
+void SearchServer::RefreshImpactScores() {
+    if (impact_index_.IsEnabled() && impact_index_.IsStale(GetDocumentCount())) {
+        EnableImpactScores(impact_index_.GetOptions());
+    }
 }
 
-const map<string_view, double> &SearchServer::GetWordFrequencies(int document_id) const {
-    return documents_.at(document_id).freqs;
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    query_cache_.SetCapacity(capacity);
+}
+
+QueryCacheStatistics SearchServer::GetQueryCacheStatistics() const {
+    return query_cache_.GetStatistics();
+}
+
+void SearchServer::MakeQueryCacheKey(const Query &query, PredicateKeyKind key_kind, string_view predicate_key,
+                                     size_t top_k, bool is_approximate, string &key) {
+    // Длины частей идут перед ними, поэтому разные запросы не дают одинаковых ключей
+    const size_t header[] = {static_cast<size_t>(key_kind), predicate_key.size(), top_k, query.plus_words.size(),
+                             query.minus_words.size(), is_approximate};
+    key.assign(reinterpret_cast<const char *>(header), sizeof(header));
+    key += predicate_key;
+    for (const auto *words: {&query.plus_words, &query.minus_words}) {
+        key.append(reinterpret_cast<const char *>(words->data()), words->size() * sizeof(TermId));
+    }
+}
+
+size_t SearchServer::GetDocumentTextsMemoryUsage() const {
+    return document_texts_.GetMemoryUsage();
+}
+
+size_t SearchServer::GetTermsMemoryUsage() const {
+    return terms_.GetMemoryUsage();
+}
+
+void SearchServer::SaveSnapshot(const string &path) const {
+    IndexSnapshotWriter writer;
+    for (const auto &word: stop_words_) {
+        writer.AddStopWord(word);
+    }
+    for (TermId word = 0; word < word_to_document_freqs_.size(); ++word) {
+        if (word_to_document_freqs_[word].empty()) {
+            continue;
+        }
+        vector<Posting> postings;
+        postings.reserve(word_to_document_freqs_[word].size());
+        for (PostingList::Cursor cursor(word_to_document_freqs_[word]); !cursor.IsEnd(); cursor.Next()) {
+            postings.push_back(*cursor);
+        }
+        writer.AddTerm(terms_.GetTerm(word), move(postings));
+    }
+    for (const int document_id: document_ids_) {
+        const DocumentSlot slot = GetSlot(document_id);
+        const DocumentData &document = documents_[slot];
+        vector<pair<string_view, double>> word_freqs;
+        word_freqs.reserve(document.freqs.size());
+        for (const auto &[word, term_freq]: document.freqs) {
+            word_freqs.emplace_back(terms_.GetTerm(word), term_freq);
+        }
+        writer.AddDocument(document_id, slot_ratings_[slot], slot_statuses_[slot], document_texts_.Get(document.text_id),
+                           document.word_count, move(word_freqs));
+    }
+    writer.Write(path);
+}
+
+SearchServer SearchServer::LoadSnapshot(const string &path) {
+    // Номера и смещения записей проверяет конструктор снимка, здесь - то, на чем держатся инварианты сервера:
+    // id документов и слова различны, вхождения ссылаются на документ своего слота
+    const IndexSnapshot snapshot(path);
+    const auto &header = *snapshot.header_;
+    auto check = [&path](bool valid) {
+        if (!valid) {
+            throw invalid_argument("Index snapshot " + path + " is inconsistent.");
+        }
+    };
+    SearchServer search_server;
+
+    for (uint32_t i = 0; i < header.stop_word_count; ++i) {
+        search_server.stop_words_.emplace(snapshot.GetString(snapshot.stop_words_[i]));
+    }
+    vector<TermId> term_ids(header.term_count);
+    for (uint32_t i = 0; i < header.term_count; ++i) {
+        const string_view word = snapshot.GetString(snapshot.terms_[i].word);
+        check(i == 0 || snapshot.GetString(snapshot.terms_[i - 1].word) < word);
+        term_ids[i] = search_server.terms_.Intern(word);
+    }
+    search_server.word_to_document_freqs_.resize(search_server.terms_.size());
+
+    // Документы в снимке идут по возрастанию id, а слот документа во вхождениях - его номер в снимке,
+    // поэтому слоты нового сервера совпадают со слотами снимка
+    for (uint32_t i = 0; i < header.document_count; ++i) {
+        const auto &record = snapshot.documents_[i];
+        check(record.id >= 0 && (i == 0 || snapshot.documents_[i - 1].id < record.id));
+        const DocumentSlot slot = search_server.AcquireSlot(record.id, static_cast<DocumentStatus>(record.status),
+                                                            record.rating);
+        DocumentData &document = search_server.documents_[slot];
+        for (uint64_t j = record.terms_begin; j < record.terms_begin + record.term_count; ++j) {
+            check(j == record.terms_begin || snapshot.document_terms_[j - 1].term < snapshot.document_terms_[j].term);
+            document.freqs.emplace_back(term_ids[snapshot.document_terms_[j].term],
+                                        snapshot.document_terms_[j].term_freq);
+        }
+        sort(document.freqs.begin(), document.freqs.end());
+        document.text_id = search_server.document_texts_.Store(snapshot.GetString(record.text));
+        document.word_count = record.word_count;
+    }
+    for (uint32_t i = 0; i < header.term_count; ++i) {
+        const auto &term = snapshot.terms_[i];
+        auto &postings = search_server.word_to_document_freqs_[term_ids[i]];
+        for (uint64_t j = term.postings_begin; j < term.postings_begin + term.posting_count; ++j) {
+            const Posting &posting = snapshot.postings_[j];
+            check(posting.document_id == snapshot.documents_[posting.slot].id &&
+                  (j == term.postings_begin || snapshot.postings_[j - 1].document_id < posting.document_id));
+            postings.Insert(posting.document_id, posting.slot, posting.term_freq);
+        }
+    }
+    return search_server;
+}
+
+vector<SearchServer::DocumentIdRange> SearchServer::SplitIntoDocumentRanges(const Query &query,
+                                                                            size_t range_count) const {
+    if (document_ids_.empty()) {
+        return {};
+    }
+    size_t plus_posting_count = 0;
+    for (const TermId word: query.plus_words) {
+        plus_posting_count += word_to_document_freqs_[word].size();
+    }
+    const int64_t first_id = *document_ids_.begin();
+    const int64_t id_count = *document_ids_.rbegin() - first_id + 1;
+    range_count = max<size_t>(1, min({range_count, plus_posting_count / MIN_RANGE_POSTING_COUNT,
+                                      static_cast<size_t>(id_count)}));
+
+    // Id делятся поровну, а не по числу вхождений: границы считаются без обхода списков
+    vector<DocumentIdRange> ranges(range_count);
+    for (size_t i = 0; i < range_count; ++i) {
+        ranges[i].first_id = static_cast<int>(first_id + id_count * static_cast<int64_t>(i) / range_count);
+        ranges[i].last_id = static_cast<int>(first_id + id_count * static_cast<int64_t>(i + 1) / range_count - 1);
+    }
+    return ranges;
+}
+
+
+[[nodiscard]] double SearchServer::ComputeWordInverseDocumentFreq(TermId word) const {
+    if (corpus_statistics_ == nullptr) {
+        return log(GetDocumentCount() / static_cast<double>(word_to_document_freqs_[word].size()));
+    }
+    // Слово может остаться только в удаленных из корпуса документах, их вклад не учитывается
+    const size_t document_freq = corpus_statistics_->GetDocumentFrequency(terms_.GetTerm(word));
+    if (document_freq == 0) {
+        return 0;
+    }
+    return log(corpus_statistics_->GetDocumentCount() / static_cast<double>(document_freq));
+}
+
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    map<string_view, double> word_frequencies;
+    for (const auto &[word, term_freq]: documents_[GetSlot(document_id)].freqs) {
+        word_frequencies.emplace(terms_.GetTerm(word), term_freq);
+    }
+    return word_frequencies;
+}
+
+DocumentToAdd SearchServer::ExportDocument(int document_id) const {
+    const DocumentSlot slot = GetSlot(document_id);
+    return {document_id, document_texts_.Get(documents_[slot].text_id), slot_statuses_[slot], {slot_ratings_[slot]}};
+}
+
+void SearchServer::SetCorpusStatistics(const CorpusStatistics *corpus_statistics) {
+    ++generation_;
+    corpus_statistics_ = corpus_statistics;
+    if (impact_index_.IsEnabled()) {
+        EnableImpactScores(impact_index_.GetOptions());
+    }
+}
+
+void SearchServer::SetTaskScheduler(TaskScheduler &task_scheduler) {
+    task_scheduler_ = &task_scheduler;
+}
+
+TaskScheduler &SearchServer::GetTaskScheduler() const {
+    return *task_scheduler_;
 }
 
 [[nodiscard]] vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
     vector<string_view> words;
-    for (const auto &word: SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
+    ForEachWord(text, [this, &words](string_view word, bool is_valid_word) {
+        if (!is_valid_word) {
             throw invalid_argument("Document's content should not contains special characters.");
         }
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
-    }
+    });
     return words;
 }
\ No newline at end of file
@@ -8,23 +8,61 @@
 
 #include <algorithm>
 #include <cmath>
-#include <deque>
+#include <exception>
 #include <execution>
 #include <future>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
 #include <numeric>
 #include <set>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include "corpus_statistics.h"
 #include "document.h"
+#include "document_filter.h"
+#include "impact_index.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "task_scheduler.h"
 #include "log_duration.h"
+#include "posting_list.h"
+#include "query_cache.h"
+#include "score_accumulator.h"
+#include "scratch_object.h"
+#include "term_dictionary.h"
+#include "text_arena.h"
+#include "top_documents.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const int BUCKETS_NUMBER = 100;
-const double EPSILON = 1e-6;
 
+// Стратегии вычисления запроса, передаются в FindTopDocuments вместо политики выполнения
+namespace query_evaluation {
+    // Обход документов по возрастанию id с отсечением MaxScore: документ, который по верхней оценке
+    // релевантности не может попасть в выдачу, не оценивается до конца
+    struct MaxScorePolicy {
+    };
+
+    inline constexpr MaxScorePolicy max_score{};
+
+    // Подсчет по квантованным импактам (см. SearchServer::EnableImpactScores): релевантность - сумма
+    // целых импактов, отличается от точной не больше чем на GetImpactScoreError() на каждое слово запроса.
+    // Документ, который уже не может обогнать отобранные, не заводится, а предикат проверяется
+    // только у претендентов на выдачу.
+    struct ImpactScorePolicy {
+    };
+
+    inline constexpr ImpactScorePolicy impact_scores{};
+}
+
+// Документ для пакетного добавления, поля - как у аргументов AddDocument
+struct DocumentToAdd {
+    int document_id;
+    std::string_view document;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
 
 class SearchServer {
 public:
@@ -49,6 +87,15 @@ public:
     void
     AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
 
+    // Добавляет документы пачкой. Сначала проверяются все документы: при ошибке бросается то же исключение,
+    // что бросил бы AddDocument для первого некорректного документа пачки, и сервер не меняется.
+    // Параллельная версия разбирает тексты и строит частичные индексы частей пачки в разных потоках.
+    void AddDocuments(const std::vector<DocumentToAdd> &documents);
+
+    void AddDocuments(const std::execution::sequenced_policy &policy, const std::vector<DocumentToAdd> &documents);
+
+    void AddDocuments(const std::execution::parallel_policy &policy, const std::vector<DocumentToAdd> &documents);
+
     // REMOVE DOCUMENT
 
     void RemoveDocument(int document_id);
@@ -57,32 +104,103 @@ public:
 
     void RemoveDocument(const std::execution::parallel_policy &policy, int document_id);
 
+    // Удаляет документы пачкой: каждый список вхождений проходится один раз на всю пачку.
+    // Отсутствующие id пропускаются.
+    void RemoveDocuments(const std::vector<int> &document_ids);
+
+    void RemoveDocuments(const std::execution::sequenced_policy &policy, const std::vector<int> &document_ids);
+
+    void RemoveDocuments(const std::execution::parallel_policy &policy, const std::vector<int> &document_ids);
+
     // GET DOCUMENTS
 
-    auto GetDocuments() { return documents_; }
+    // Слова документа по возрастанию TermId с их частотами, без копирования.
+    // Ссылка действительна до удаления документа.
+    [[nodiscard]] const std::vector<std::pair<TermId, double>> &GetDocumentTerms(int document_id) const;
 
     [[nodiscard]] int GetDocumentCount() const;
 
+    [[nodiscard]] bool HasDocument(int document_id) const;
+
     // FIND DOCUMENTS
 
+    // top_k - сколько лучших документов вернуть
+
     template<typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template<typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     [[nodiscard]] std::vector<Document>
-    FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                     size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template<typename ExecutionPolicy>
     std::vector<Document>
     FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
-                     DocumentStatus status = DocumentStatus::ACTUAL) const;
+                     DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Поиск с фильтром, а не предикатом: вхождение проверяется по битовой карте слотов со статусом фильтра
+    // и по столбцу рейтингов до подсчета релевантности, без вызова предиката. Поиск по статусу идет этим же путем.
+    [[nodiscard]] std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, const DocumentFilter &filter,
+                     size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template<typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                           const DocumentFilter &filter,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Поиск с предикатом через кеш выдачи. predicate_key должен однозначно задавать отбор документов:
+    // запросы с одинаковыми словами и ключом получат одну и ту же выдачу.
+    // Поиск по статусу кешируется без отдельного ключа.
+    template<typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsCached(const ExecutionPolicy &policy, std::string_view raw_query,
+                                                 std::string_view predicate_key, DocumentPredicate document_predicate,
+                                                 size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Версии, которые записывают выдачу в documents. Память documents используется для отбора лучших,
+    // а буферы разбора запроса берутся из пула потока, поэтому последовательный поиск без кеша
+    // не выделяет память, если емкости documents хватает на top_k документов.
+    // Поиск через кеш выделяет память только при промахе.
+
+    template<typename ExecutionPolicy, typename DocumentPredicate>
+    void FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                          DocumentPredicate document_predicate, size_t top_k,
+                          std::vector<Document> &documents) const;
+
+    template<typename ExecutionPolicy>
+    void FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status,
+                          size_t top_k, std::vector<Document> &documents) const;
+
+    template<typename ExecutionPolicy>
+    void FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, const DocumentFilter &filter,
+                          size_t top_k, std::vector<Document> &documents) const;
+
+    template<typename ExecutionPolicy, typename DocumentPredicate>
+    void FindTopDocumentsCached(const ExecutionPolicy &policy, std::string_view raw_query,
+                                std::string_view predicate_key, DocumentPredicate document_predicate,
+                                size_t top_k, std::vector<Document> &documents) const;
+
+    // QUERY CACHE
+
+    // Включает кеш выдачи на capacity запросов, 0 - выключает. Ключ - разобранный запрос (плюс- и минус-слова
+    // без повторов, по порядку) и отбор документов. Любое изменение индекса делает записи кеша устаревшими.
+    // Сервер с внешней статистикой корпуса (см. SetCorpusStatistics) кеш не использует:
+    // статистика может измениться без ведома сервера.
+    void SetQueryCacheCapacity(size_t capacity);
+
+    [[nodiscard]] QueryCacheStatistics GetQueryCacheStatistics() const;
 
 
     // MATCH DOCUMENTS
 
+    // Слова выдачи указывают в словарь сервера. Добавление документов их не трогает, а удаление документов
+    // освобождает слова, которых больше нет ни в одном документе, поэтому выдача действительна до удаления.
     using MatchDocumentResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
     [[nodiscard]] MatchDocumentResult MatchDocument(std::string_view raw_query, int document_id) const;
@@ -95,7 +213,54 @@ public:
 
     // TOOLS
 
-    [[nodiscard]] const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
+    [[nodiscard]] std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    // Документ в виде, пригодном для AddDocument другого сервера: текст указывает в хранилище
+    // этого сервера и действителен до его изменения, вместо оценок - средняя оценка
+    [[nodiscard]] DocumentToAdd ExportDocument(int document_id) const;
+
+    // IDF будет считаться по статистике всего корпуса, если сервер хранит его часть
+    // (см. SegmentedSearchServer); nullptr - по документам самого сервера.
+    // Сервер не владеет статистикой, его копии ссылаются на нее же.
+    void SetCorpusStatistics(const CorpusStatistics *corpus_statistics);
+
+    // Планировщик, на котором выполняются параллельные версии методов (std::execution::par)
+    // и ProcessQueries; по умолчанию - TaskScheduler::GetDefault(). Сервер не владеет планировщиком,
+    // его копии работают на нем же.
+    void SetTaskScheduler(TaskScheduler &task_scheduler);
+
+    [[nodiscard]] TaskScheduler &GetTaskScheduler() const;
+
+    // Сжимает списки вхождений (см. PostingList). Документы, добавленные после сжатия,
+    // хранятся несжатыми до следующего вызова.
+    void CompressPostings();
+
+    [[nodiscard]] PostingsMemoryUsage GetPostingsMemoryUsage() const;
+
+    // Включает индекс квантованных импактов для query_evaluation::impact_scores и пересчитывает его.
+    // Индекс обновляется при каждом изменении, а целиком пересчитывается, когда число документов
+    // уходит от числа при пересчете больше чем на options.max_document_count_drift.
+    // Без индекса impact_scores считает релевантность точно.
+    void EnableImpactScores(ImpactScoreOptions options = {});
+
+    void DisableImpactScores();
+
+    // Наибольшая ошибка квантования вклада одного слова запроса в релевантность сразу после пересчета
+    [[nodiscard]] double GetImpactScoreError() const;
+
+    // Память под тексты документов, пропорциональна текстам живых документов (см. TextArena)
+    [[nodiscard]] size_t GetDocumentTextsMemoryUsage() const;
+
+    // Память словаря, пропорциональна наибольшему числу одновременно живых слов (см. TermDictionary)
+    [[nodiscard]] size_t GetTermsMemoryUsage() const;
+
+    // Сохраняет индекс в бинарный снимок, по которому можно искать без загрузки (см. IndexSnapshot)
+    void SaveSnapshot(const std::string &path) const;
+
+    // Восстанавливает сервер из снимка: слова и вхождения берутся готовыми, тексты не разбираются.
+    // Испорченный снимок - runtime_error (см. IndexSnapshot), снимок с повторами id документов или слов
+    // и вхождениями не своих документов - invalid_argument
+    static SearchServer LoadSnapshot(const std::string &path);
 
     // ITERATORS
 
@@ -103,19 +268,47 @@ public:
 
     std::set<int>::iterator end();
 
+    [[nodiscard]] std::set<int>::const_iterator begin() const;
+
+    [[nodiscard]] std::set<int>::const_iterator end() const;
+
 private:
     struct DocumentData {
-        std::map<std::string_view, double> freqs;
-        int rating;
-        DocumentStatus status;
+        // Отсортированы по TermId
+        std::vector<std::pair<TermId, double>> freqs;
+        // Номер, а не string_view: хранилище переносит тексты, а копия сервера не должна
+        // ссылаться на тексты оригинала
+        TextId text_id;
+        uint32_t word_count;
     };
 
     TransparentStringSet stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::deque<std::string> dictionary_;
-
-    std::map<int, DocumentData> documents_;
+    TermDictionary terms_;
+    // Индекс в векторе - TermId
+    std::vector<PostingList> word_to_document_freqs_;
+    TextArena document_texts_;
+
+    // Документы хранятся по слотам. То, что поиск читает для каждого вхождения, лежит отдельными
+    // плотными столбцами, остальное - в documents_. Индекс в векторах - слот документа.
+    std::unordered_map<int, DocumentSlot> document_slots_;
     std::set<int> document_ids_;
+    std::vector<DocumentData> documents_;
+    // Для свободного слота хранится -1
+    std::vector<int> slot_documents_;
+    std::vector<DocumentStatus> slot_statuses_;
+    std::vector<int> slot_ratings_;
+    std::vector<DocumentSlot> free_slots_;
+    // Битовые карты слотов: занятых и с каждым статусом, индекс в векторе - статус
+    DocumentBitmap live_documents_;
+    std::vector<DocumentBitmap> status_documents_;
+    const CorpusStatistics *corpus_statistics_ = nullptr;
+    TaskScheduler *task_scheduler_ = &TaskScheduler::GetDefault();
+    ImpactIndex impact_index_;
+    // Увеличивается при каждом изменении, от которого может измениться выдача
+    uint64_t generation_ = 0;
+    mutable QueryCache query_cache_;
+    // Карты документов с частыми минус-словами, см. CollectExcludedDocuments
+    mutable WordBitmapCache minus_word_bitmaps_;
 
     struct QueryWord {
         std::string_view data;
@@ -123,40 +316,162 @@ private:
         bool is_stop;
     };
 
+    // Слова, которых нет в словаре, ни с одним документом не совпадают и в запрос не попадают
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
     };
 
-    // PRIVATE METHODS
+    // Буферы разбора запроса, переиспользуются потоком между запросами (см. ScratchObject)
+    struct QueryContext {
+        Query query;
+        std::string cache_key;
+    };
 
-    static bool IsValidWord(std::string_view word);
+    // Передается в FindAllDocuments вместо предиката: документ подходит, если его слот есть в битовой карте,
+    // а рейтинг из столбца рейтингов лежит в отрезке
+    struct SlotFilter {
+        const DocumentBitmap *slots;
+        int min_rating;
+        int max_rating;
+    };
+
+    // PRIVATE METHODS
 
     [[nodiscard]] bool IsStopWord(std::string_view word) const;
 
     [[nodiscard]] std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
 
+    // Занимает слот под новый документ и заполняет его столбцы
+    DocumentSlot AcquireSlot(int document_id, DocumentStatus status, int rating);
+
+    // Слот существующего документа, для отсутствующего бросает out_of_range
+    [[nodiscard]] DocumentSlot GetSlot(int document_id) const;
+
+    void ReleaseSlot(DocumentSlot slot);
+
+    // Частичный индекс части пачки документов: слова пронумерованы внутри части
+    struct PartialIndex {
+        std::vector<std::string_view> words;
+        // Для каждого документа части - номера его слов с частотами, отсортированы по номеру слова
+        std::vector<std::vector<std::pair<uint32_t, double>>> document_words;
+        std::vector<uint32_t> word_counts;
+    };
+
+    // Разбирает документы [first, last) пачки; ошибки разбора записываются в errors
+    [[nodiscard]] PartialIndex BuildPartialIndex(const std::vector<DocumentToAdd> &documents, size_t first,
+                                                 size_t last, std::vector<std::exception_ptr> &errors) const;
+
+    template<typename ExecutionPolicy>
+    void AddDocumentsImpl(const ExecutionPolicy &policy, const std::vector<DocumentToAdd> &documents,
+                          size_t part_count);
+
+    // Удаляет слово из словаря, если его больше нет ни в одном документе; TermId достанется новому слову
+    void ReleaseTermIfUnused(TermId word);
+
+    // Для каждого слова документов из document_ids - отсортированные id содержащих его документов
+    [[nodiscard]] std::vector<std::pair<TermId, std::vector<int>>>
+    GroupDocumentsByTerm(const std::vector<int> &document_ids) const;
+
+    // Удаляет сведения о документе, вхождения которого уже удалены
+    void EraseDocumentData(int document_id);
+
+    // Добавляет вхождения нового документа в индекс импактов
+    void IndexImpactScores(DocumentSlot slot);
+
+    // Пересчитывает индекс импактов, если он включен и устарел; вызывается в конце каждого изменения
+    void RefreshImpactScores();
+
     // QUERY METHODS
 
-    [[nodiscard]] QueryWord ParseQueryWord(std::string_view word) const;
+    [[nodiscard]] QueryWord ParseQueryWord(std::string_view word, bool is_valid_word) const;
 
     [[nodiscard]] Query ParseQuery(std::string_view text, bool skip_sort = false) const;
 
+    // Разбирает запрос в query, переиспользуя память его векторов
+    void ParseQuery(std::string_view text, Query &query, bool skip_sort = false) const;
+
+    template<typename ExecutionPolicy, typename DocumentPredicate>
+    void FindTopDocumentsByQuery(const ExecutionPolicy &policy, const Query &query,
+                                 DocumentPredicate document_predicate, size_t top_k,
+                                 std::vector<Document> &documents) const;
+
+    // Чей ключ отбора попал в кеш: ключи DocumentFilter не должны совпадать с ключами пользователя
+    enum class PredicateKeyKind {
+        USER,
+        FILTER,
+    };
+
+    template<typename ExecutionPolicy, typename DocumentPredicate>
+    void FindTopDocumentsCached(const ExecutionPolicy &policy, std::string_view raw_query, PredicateKeyKind key_kind,
+                                std::string_view predicate_key, DocumentPredicate document_predicate, size_t top_k,
+                                std::vector<Document> &documents) const;
+
+    // Записывает ключ в key. is_approximate - выдача посчитана приближенно и не должна попадать в точные запросы
+    static void MakeQueryCacheKey(const Query &query, PredicateKeyKind key_kind, std::string_view predicate_key,
+                                  size_t top_k, bool is_approximate, std::string &key);
+
     // Existence required
-    [[nodiscard]] double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    [[nodiscard]] double ComputeWordInverseDocumentFreq(TermId word) const;
+
+    [[nodiscard]] SlotFilter MakeSlotFilter(const DocumentFilter &filter) const;
 
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query &query, DocumentPredicate document_predicate) const;
+    [[nodiscard]] bool IsSelected(DocumentPredicate &document_predicate, int document_id, DocumentSlot slot) const;
+
+    // Найденные документы сразу передаются в top_documents, который оставляет только лучшие
 
     template<typename DocumentPredicate>
-    std::vector<Document>
-    FindAllDocuments(const std::execution::sequenced_policy &, const Query &query,
-                     DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const Query &query, DocumentPredicate document_predicate,
+                          TopDocuments &top_documents) const;
 
     template<typename DocumentPredicate>
-    std::vector<Document>
-    FindAllDocuments(const std::execution::parallel_policy &, const Query &query,
-                     DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const std::execution::sequenced_policy &, const Query &query,
+                          DocumentPredicate document_predicate, TopDocuments &top_documents) const;
+
+    template<typename DocumentPredicate>
+    void FindAllDocuments(const std::execution::parallel_policy &, const Query &query,
+                          DocumentPredicate document_predicate, TopDocuments &top_documents) const;
+
+    template<typename DocumentPredicate>
+    void FindAllDocuments(const query_evaluation::MaxScorePolicy &, const Query &query,
+                          DocumentPredicate document_predicate, TopDocuments &top_documents) const;
+
+    template<typename DocumentPredicate>
+    void FindAllDocuments(const query_evaluation::ImpactScorePolicy &, const Query &query,
+                          DocumentPredicate document_predicate, TopDocuments &top_documents) const;
+
+    // Документы с id от first_id до last_id включительно
+    struct DocumentIdRange {
+        int first_id;
+        int last_id;
+    };
+
+    // Считает релевантность документов из range по всем плюс-словам запроса. Вхождения документов
+    // с минус-словами пропускаются до проверки предиката и подсчета релевантности: по битовой карте
+    // excluded, а если она не собрана (nullptr) - поиском галопом в списках минус-слов
+    template<typename DocumentPredicate>
+    void AccumulateRelevance(const Query &query, DocumentPredicate document_predicate,
+                             const DocumentBitmap *excluded, DocumentIdRange range,
+                             ScoreAccumulator &document_to_relevance) const;
+
+    // Собирает в excluded слоты документов с минус-словами и возвращает &excluded. Если минус-слов нет
+    // или сборка дороже поиска галопом (вхождений плюс-слов мало), возвращает nullptr.
+    // Карты частых минус-слов строятся один раз на поколение индекса и дальше только объединяются.
+    [[nodiscard]] const DocumentBitmap *CollectExcludedDocuments(const Query &query, DocumentBitmap &excluded) const;
+
+    void CollectTopDocuments(const ScoreAccumulator &document_to_relevance, TopDocuments &top_documents) const;
+
+    // Вызывает function(i) для i из [0, count): по порядку или на планировщике сервера
+    template<typename Function>
+    void ForEachIndex(const std::execution::sequenced_policy &, size_t count, Function function) const;
+
+    template<typename Function>
+    void ForEachIndex(const std::execution::parallel_policy &, size_t count, Function function) const;
+
+    // Делит id документов на не больше чем range_count отрезков одной длины. Отрезков меньше,
+    // если вхождений плюс-слов слишком мало, чтобы окупить параллельный подсчет.
+    [[nodiscard]] std::vector<DocumentIdRange> SplitIntoDocumentRanges(const Query &query, size_t range_count) const;
 };
 
 template<typename StringCollection>
@@ -169,119 +484,445 @@ SearchServer::SearchServer(const StringCollection &stop_words): stop_words_(Make
 
 template<typename DocumentPredicate>
 std::vector<Document>
-SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
 }
 
 template<typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
-                                                     DocumentPredicate document_predicate) const {
+                                                     DocumentPredicate document_predicate, size_t top_k) const {
+    std::vector<Document> documents;
+    FindTopDocuments(policy, raw_query, document_predicate, top_k, documents);
+    return documents;
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status,
+                               size_t top_k) const {
+    std::vector<Document> documents;
+    FindTopDocuments(policy, raw_query, status, top_k, documents);
+    return documents;
+}
+
+template<typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, const DocumentFilter &filter,
+                               size_t top_k) const {
+    std::vector<Document> documents;
+    FindTopDocuments(policy, raw_query, filter, top_k, documents);
+    return documents;
+}
+
+template<typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document>
+SearchServer::FindTopDocumentsCached(const ExecutionPolicy &policy, std::string_view raw_query,
+                                     std::string_view predicate_key, DocumentPredicate document_predicate,
+                                     size_t top_k) const {
+    std::vector<Document> documents;
+    FindTopDocumentsCached(policy, raw_query, predicate_key, document_predicate, top_k, documents);
+    return documents;
+}
+
+template<typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                    DocumentPredicate document_predicate, size_t top_k,
+                                    std::vector<Document> &documents) const {
+#if TEST_MODE
+    std::cout << "Результаты поиска по запросу: " << raw_query << std::endl;
+    SEARCH_SERVER_DURATION;
+#endif
+
+    ScratchObject<QueryContext> context;
+    ParseQuery(raw_query, context->query);
+    FindTopDocumentsByQuery(policy, context->query, document_predicate, top_k, documents);
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status,
+                                    size_t top_k, std::vector<Document> &documents) const {
+    DocumentFilter filter;
+    filter.status = status;
+    FindTopDocuments(policy, raw_query, filter, top_k, documents);
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                    const DocumentFilter &filter, size_t top_k,
+                                    std::vector<Document> &documents) const {
+    const int filter_key[] = {filter.status.has_value(),
+                              static_cast<int>(filter.status.value_or(DocumentStatus::ACTUAL)),
+                              filter.min_rating, filter.max_rating};
+    FindTopDocumentsCached(policy, raw_query, PredicateKeyKind::FILTER,
+                           std::string_view(reinterpret_cast<const char *>(filter_key), sizeof(filter_key)),
+                           MakeSlotFilter(filter), top_k, documents);
+}
+
+template<typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::FindTopDocumentsCached(const ExecutionPolicy &policy, std::string_view raw_query,
+                                          std::string_view predicate_key, DocumentPredicate document_predicate,
+                                          size_t top_k, std::vector<Document> &documents) const {
+    FindTopDocumentsCached(policy, raw_query, PredicateKeyKind::USER, predicate_key, document_predicate, top_k,
+                           documents);
+}
+
+template<typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::FindTopDocumentsCached(const ExecutionPolicy &policy, std::string_view raw_query,
+                                          PredicateKeyKind key_kind, std::string_view predicate_key,
+                                          DocumentPredicate document_predicate, size_t top_k,
+                                          std::vector<Document> &documents) const {
 #if TEST_MODE
     std::cout << "Результаты поиска по запросу: " << raw_query << std::endl;
     SEARCH_SERVER_DURATION;
 #endif
 
-    const auto query = ParseQuery(raw_query);
+    ScratchObject<QueryContext> context;
+    ParseQuery(raw_query, context->query);
+    if (corpus_statistics_ != nullptr || !query_cache_.IsEnabled()) {
+        FindTopDocumentsByQuery(policy, context->query, document_predicate, top_k, documents);
+        return;
+    }
+    MakeQueryCacheKey(context->query, key_kind, predicate_key, top_k,
+                      std::is_same_v<ExecutionPolicy, query_evaluation::ImpactScorePolicy>, context->cache_key);
+    if (query_cache_.Find(context->cache_key, generation_, documents)) {
+        return;
+    }
+    FindTopDocumentsByQuery(policy, context->query, document_predicate, top_k, documents);
+    query_cache_.Insert(context->cache_key, generation_, documents);
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template<typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::FindTopDocumentsByQuery(const ExecutionPolicy &policy, const Query &query,
+                                           DocumentPredicate document_predicate, size_t top_k,
+                                           std::vector<Document> &documents) const {
+    TopDocuments top_documents(top_k, std::move(documents));
+    FindAllDocuments(policy, query, document_predicate, top_documents);
+    documents = top_documents.Build();
+}
 
-    sort(matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template<typename DocumentPredicate>
+bool SearchServer::IsSelected(DocumentPredicate &document_predicate, int document_id, DocumentSlot slot) const {
+    if constexpr (std::is_same_v<DocumentPredicate, SlotFilter>) {
+        return document_predicate.slots->Test(slot) && document_predicate.min_rating <= slot_ratings_[slot] &&
+               slot_ratings_[slot] <= document_predicate.max_rating;
+    } else {
+        return document_predicate(document_id, slot_statuses_[slot], slot_ratings_[slot]);
     }
-    return matched_documents;
 }
 
-template<typename ExecutionPolicy>
-std::vector<Document>
-SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus doc_status,
-                                                        int rating) {
-        return doc_status == status;
-    });
+template<typename Function>
+void SearchServer::ForEachIndex(const std::execution::sequenced_policy &, size_t count, Function function) const {
+    for (size_t i = 0; i < count; ++i) {
+        function(i);
+    }
+}
+
+template<typename Function>
+void SearchServer::ForEachIndex(const std::execution::parallel_policy &, size_t count, Function function) const {
+    task_scheduler_->ParallelFor(count, function);
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query &query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+void SearchServer::FindAllDocuments(const Query &query, DocumentPredicate document_predicate,
+                                    TopDocuments &top_documents) const {
+    FindAllDocuments(std::execution::seq, query, document_predicate, top_documents);
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy &policy, const Query &query,
-                                                     DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+void SearchServer::FindAllDocuments(const std::execution::sequenced_policy &, const Query &query,
+                                    DocumentPredicate document_predicate, TopDocuments &top_documents) const {
+    ScratchObject<DocumentBitmap> excluded_buffer;
+    const DocumentBitmap *excluded = CollectExcludedDocuments(query, *excluded_buffer);
+    ScratchScoreAccumulator document_to_relevance(slot_documents_.size());
+
+    AccumulateRelevance(query, document_predicate, excluded, {0, std::numeric_limits<int>::max()},
+                        *document_to_relevance);
+    CollectTopDocuments(*document_to_relevance, top_documents);
+}
+
+template<typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const std::execution::parallel_policy &policy, const Query &query,
+                                    DocumentPredicate document_predicate, TopDocuments &top_documents) const {
+    // Исключенные документы отмечаются до подсчета, и все отрезки читают одну битовую карту
+    ScratchObject<DocumentBitmap> excluded_buffer;
+    const DocumentBitmap *excluded = CollectExcludedDocuments(query, *excluded_buffer);
+    // Каждый отрезок id считается по всем словам в свой аккумулятор и отбирает свои лучшие документы,
+    // поэтому параллельность не ограничена числом слов запроса. Отрезков больше, чем потоков,
+    // чтобы неравномерно распределенные документы не задерживали один из них.
+    const auto ranges = SplitIntoDocumentRanges(query, 4 * task_scheduler_->GetThreadCount());
+    std::vector<std::vector<Document>> range_documents(ranges.size());
+
+    ForEachIndex(policy, ranges.size(), [&](size_t i) {
+        ScratchScoreAccumulator document_to_relevance(slot_documents_.size());
+        AccumulateRelevance(query, document_predicate, excluded, ranges[i], *document_to_relevance);
+        TopDocuments range_top_documents(top_documents.GetTopK());
+        CollectTopDocuments(*document_to_relevance, range_top_documents);
+        range_documents[i] = range_top_documents.Build();
+    });
+
+    for (const auto &documents: range_documents) {
+        for (const Document &document: documents) {
+            top_documents.Add(document);
+        }
+    }
+}
+
+template<typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const query_evaluation::MaxScorePolicy &, const Query &query,
+                                    DocumentPredicate document_predicate, TopDocuments &top_documents) const {
+    struct TermCursor {
+        PostingList::Cursor current;
+        double inverse_document_freq;
+        double max_score;
+    };
 
-    for (auto word: query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    std::vector<TermCursor> cursors;
+    for (const TermId word: query.plus_words) {
+        const auto &postings = word_to_document_freqs_[word];
+        if (postings.empty()) {
             continue;
         }
-        const auto inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto &[document_id, term_freq]: word_to_document_freqs_.at(word)) {
-            const auto &document = documents_.at(document_id);
-            if (document_predicate(document_id, document.status, document.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        cursors.push_back({PostingList::Cursor(postings), inverse_document_freq,
+                           postings.GetMaxTermFreq() * inverse_document_freq});
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const TermCursor &lhs, const TermCursor &rhs) {
+        return lhs.max_score < rhs.max_score;
+    });
+    // max_score_prefix[i] - верхняя оценка релевантности документа, найденного только в словах 0..i
+    std::vector<double> max_score_prefix(cursors.size());
+    double max_score_sum = 0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        max_score_sum += cursors[i].max_score;
+        max_score_prefix[i] = max_score_sum;
+    }
+
+    std::vector<PostingList::Cursor> minus_cursors;
+    for (const TermId word: query.minus_words) {
+        minus_cursors.emplace_back(word_to_document_freqs_[word]);
+    }
+    // Документы перебираются по возрастанию id, поэтому курсоры минус-слов двигаются только вперед
+    auto is_excluded = [&minus_cursors](int document_id) {
+        for (auto &cursor: minus_cursors) {
+            cursor.Seek(document_id);
+            if (!cursor.IsEnd() && cursor->document_id == document_id) {
+                return true;
             }
         }
-    }
+        return false;
+    };
+
+    // Слова [0, first_essential) не обязательные: документ, найденный только в них, в выдачу не попадет
+    size_t first_essential = 0;
+    while (true) {
+        // Документ проигрывает отобранным, если его оценка ниже порога хотя бы на EPSILON
+        const double threshold = top_documents.GetThreshold() - EPSILON;
+        while (first_essential < cursors.size() && max_score_prefix[first_essential] <= threshold) {
+            ++first_essential;
+        }
+
+        int document_id = std::numeric_limits<int>::max();
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].current.IsEnd()) {
+                document_id = std::min(document_id, cursors[i].current->document_id);
+            }
+        }
+        if (document_id == std::numeric_limits<int>::max()) {
+            break;
+        }
 
-    for (const auto &word: query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        double relevance = 0;
+        DocumentSlot slot = 0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            auto &cursor = cursors[i];
+            if (!cursor.current.IsEnd() && cursor.current->document_id == document_id) {
+                relevance += cursor.current->term_freq * cursor.inverse_document_freq;
+                slot = cursor.current->slot;
+                cursor.current.Next();
+            }
+        }
+        bool is_pruned = false;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (relevance + max_score_prefix[i] <= threshold) {
+                is_pruned = true;
+                break;
+            }
+            auto &cursor = cursors[i];
+            cursor.current.Seek(document_id);
+            if (!cursor.current.IsEnd() && cursor.current->document_id == document_id) {
+                relevance += cursor.current->term_freq * cursor.inverse_document_freq;
+            }
+        }
+        if (is_pruned || is_excluded(document_id)) {
             continue;
         }
-        for (const auto &[document_id, _]: word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        if (IsSelected(document_predicate, document_id, slot)) {
+            top_documents.Add(Document(document_id, relevance, slot_ratings_[slot]));
         }
     }
+}
+
+template<typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const query_evaluation::ImpactScorePolicy &, const Query &query,
+                                    DocumentPredicate document_predicate, TopDocuments &top_documents) const {
+    if (!impact_index_.IsEnabled()) {
+        FindAllDocuments(std::execution::seq, query, document_predicate, top_documents);
+        return;
+    }
+    const size_t top_k = top_documents.GetTopK();
+    if (top_k == 0) {
+        return;
+    }
+
+    // Слова обходятся по убыванию наибольшего импакта
+    std::vector<TermId> words = query.plus_words;
+    std::sort(words.begin(), words.end(), [this](TermId lhs, TermId rhs) {
+        return impact_index_.GetMaxImpact(lhs) > impact_index_.GetMaxImpact(rhs);
+    });
+    // rest_max_impacts[i] - наибольший вклад слов после i-го
+    std::vector<uint32_t> rest_max_impacts(words.size(), 0);
+    for (size_t i = words.size(); i-- > 1;) {
+        rest_max_impacts[i - 1] = rest_max_impacts[i] + impact_index_.GetMaxImpact(words[i]);
+    }
 
-    std::vector<Document> matched_documents;
-    for (const auto &[document_id, relevance]: document_to_relevance) {
-        matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+    ScratchImpactScoreAccumulator document_to_impact(slot_documents_.size());
+    // Предикат и минус-слова проверяются только для документов, которые претендуют на выдачу:
+    // 1 - документ подходит, 2 - нет
+    ScratchImpactScoreAccumulator document_checks(slot_documents_.size());
+    auto is_suitable = [&](DocumentSlot slot) {
+        if (!document_checks->Contains(slot)) {
+            const int document_id = slot_documents_[slot];
+            const bool suitable = IsSelected(document_predicate, document_id, slot) &&
+                                  std::none_of(query.minus_words.begin(), query.minus_words.end(),
+                                               [&](TermId word) {
+                                                   return word_to_document_freqs_[word].Contains(document_id);
+                                               });
+            document_checks->Add(slot, suitable ? 1 : 2);
+        }
+        return document_checks->Get(slot) == 1;
+    };
+    // Передает накопленные документы в visit по убыванию импакта, пока visit возвращает true.
+    // Обычно нужны только лучшие, поэтому сортируется растущий префикс
+    std::vector<std::pair<uint32_t, DocumentSlot>> candidates;
+    auto visit_best = [&](auto visit) {
+        candidates.clear();
+        document_to_impact->ForEach([&candidates](DocumentSlot slot, uint32_t impact) {
+            candidates.emplace_back(impact, slot);
+        });
+        size_t sorted_count = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (i == sorted_count) {
+                sorted_count = std::min(candidates.size(), 2 * std::max(sorted_count, top_k));
+                std::partial_sort(candidates.begin() + i, candidates.begin() + sorted_count, candidates.end(),
+                                  std::greater<>());
+            }
+            if (!visit(candidates[i].first, candidates[i].second)) {
+                break;
+            }
+        }
+    };
+
+    // Импакт top_k-го подходящего документа; оценки документов только растут, поэтому порог тоже
+    uint32_t threshold = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        const auto &postings = impact_index_.GetPostings(words[i]);
+        auto posting = postings.begin();
+        for (; posting != postings.end(); ++posting) {
+            // Новый документ не наберет больше, чем этот импакт и наибольшие импакты следующих слов,
+            // а у остальных вхождений слова импакт не больше текущего
+            if (!document_to_impact->Contains(posting->slot) && posting->impact + rest_max_impacts[i] < threshold) {
+                break;
+            }
+            document_to_impact->Add(posting->slot, posting->impact);
+        }
+        for (; posting != postings.end(); ++posting) {
+            document_to_impact->AddIfPresent(posting->slot, posting->impact);
+        }
+
+        if (i + 1 < words.size()) {
+            size_t suitable_count = 0;
+            visit_best([&](uint32_t impact, DocumentSlot slot) {
+                if (is_suitable(slot) && ++suitable_count == top_k) {
+                    threshold = impact;
+                    return false;
+                }
+                return true;
+            });
+        }
     }
 
-    return matched_documents;
+    // Документы с той же релевантностью, что у последнего отобранного, тоже передаются:
+    // среди них top_documents выберет по рейтингу
+    const double scale = impact_index_.GetScale();
+    size_t suitable_count = 0;
+    double last_relevance = 0;
+    visit_best([&](uint32_t impact, DocumentSlot slot) {
+        const double relevance = impact * scale;
+        if (suitable_count >= top_k && relevance < last_relevance - EPSILON) {
+            return false;
+        }
+        if (is_suitable(slot)) {
+            const int document_id = slot_documents_[slot];
+            top_documents.Add(Document(document_id, relevance, slot_ratings_[slot]));
+            ++suitable_count;
+            last_relevance = relevance;
+        }
+        return true;
+    });
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy &policy, const Query &query,
-                                                     DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(BUCKETS_NUMBER);
-
-    std::for_each(policy,
-                  query.plus_words.begin(), query.plus_words.end(),
-                  [&](const auto &word) {
-                      if (word_to_document_freqs_.count(word) > 0) {
-                          const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                          for (const auto &[document_id, term_freq]: word_to_document_freqs_.at(word)) {
-                              const auto &document = documents_.at(document_id);
-                              if (document_predicate(document_id, document.status, document.rating)) {
-                                  document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                              }
-                          }
-                      }
-                  });
-
-    std::for_each(policy,
-                  query.minus_words.begin(), query.minus_words.end(),
-                  [&](const auto &word) {
-                      if (word_to_document_freqs_.count(word) > 0) {
-                          for (const auto &[document_id, _]: word_to_document_freqs_.at(word)) {
-                              document_to_relevance.erase(document_id);
-                          }
-                      }
-                  });
-
-    std::vector<Document> matched_documents;
-    for (const auto &[document_id, relevance]: document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+void SearchServer::AccumulateRelevance(const Query &query, DocumentPredicate document_predicate,
+                                       const DocumentBitmap *excluded, DocumentIdRange range,
+                                       ScoreAccumulator &document_to_relevance) const {
+    auto accumulate = [&](TermId word, auto is_excluded) {
+        const auto inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        PostingList::Cursor cursor(word_to_document_freqs_[word]);
+        for (cursor.Seek(range.first_id); !cursor.IsEnd(); cursor.NextBlock()) {
+            const Posting *last = cursor.BlockEnd();
+            // Отрезок кончается в этом блоке: вхождения блока отсортированы по id
+            const bool is_range_end = (last - 1)->document_id > range.last_id;
+            if (is_range_end) {
+                last = std::upper_bound(cursor.BlockBegin(), last, range.last_id,
+                                        [](int document_id, const Posting &posting) {
+                                            return document_id < posting.document_id;
+                                        });
+            }
+            for (const Posting *posting = cursor.BlockBegin(); posting != last; ++posting) {
+                const DocumentSlot slot = posting->slot;
+                if (!is_excluded(*posting) && IsSelected(document_predicate, posting->document_id, slot)) {
+                    document_to_relevance.Add(slot, posting->term_freq * inverse_document_freq);
+                }
+            }
+            if (is_range_end) {
+                break;
+            }
+        }
+    };
+
+    for (const TermId word: query.plus_words) {
+        if (excluded != nullptr) {
+            accumulate(word, [excluded](const Posting &posting) { return excluded->Test(posting.slot); });
+        } else if (query.minus_words.empty()) {
+            accumulate(word, [](const Posting &) { return false; });
+        } else {
+            // Вхождения слова идут по возрастанию id, поэтому курсоры минус-слов двигаются только вперед
+            ScratchObject<std::vector<PostingList::Cursor>> minus_cursors;
+            minus_cursors->clear();
+            for (const TermId minus_word: query.minus_words) {
+                minus_cursors->emplace_back(word_to_document_freqs_[minus_word]);
+            }
+            accumulate(word, [&minus_cursors](const Posting &posting) {
+                for (auto &cursor: *minus_cursors) {
+                    cursor.Seek(posting.document_id);
+                    if (!cursor.IsEnd() && cursor->document_id == posting.document_id) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
     }
-    return matched_documents;
 }
 
 void AddDocument(SearchServer &search_server, int document_id, std::string_view document, DocumentStatus status,
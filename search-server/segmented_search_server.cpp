@@ -0,0 +1,207 @@
+//
+// -------- Поисковой сервер из сегментов ----------
+//
+
+#include "segmented_search_server.h"
+
+using namespace std;
+
+int SegmentedSearchServer::Segment::FindLive(int document_id) const {
+    const auto it = lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    if (it == document_ids.end() || *it != document_id) {
+        return -1;
+    }
+    const auto position = static_cast<int>(it - document_ids.begin());
+    return is_deleted[position] ? -1 : position;
+}
+
+SegmentedSearchServer::SegmentedSearchServer(string_view stop_words, SegmentedSearchServerOptions options)
+        : stop_words_(stop_words), options_(options), corpus_statistics_(make_unique<CorpusStatistics>()),
+          mutable_segment_(MakeIndex()) {
+    if (options_.segment_size == 0 || options_.merge_factor < 2) {
+        throw invalid_argument("Segment size must be positive and merge factor must be at least 2.");
+    }
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    if (merge_ && merge_->result.valid()) {
+        merge_->result.wait();
+    }
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                        const vector<int> &ratings) {
+    CompleteMerge(false);
+    // Документ с тем же id может лежать в другом сегменте, поэтому id проверяется здесь, как в SearchServer
+    if (document_id < 0) throw invalid_argument("Document ID must be a natural number.");
+    if (document_ids_.count(document_id) > 0) throw invalid_argument("Document with this ID already exists.");
+
+    mutable_segment_->AddDocument(document_id, document, status, ratings);
+    corpus_statistics_->AddDocument(mutable_segment_->GetWordFrequencies(document_id));
+    document_ids_.insert(document_id);
+    if (static_cast<size_t>(mutable_segment_->GetDocumentCount()) >= options_.segment_size) {
+        SealMutableSegment();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    CompleteMerge(false);
+    if (document_ids_.erase(document_id) == 0) {
+        return;
+    }
+    for (Segment &segment: segments_) {
+        const int position = segment.FindLive(document_id);
+        if (position < 0) {
+            continue;
+        }
+        corpus_statistics_->RemoveDocument(segment.index->GetWordFrequencies(document_id));
+        segment.is_deleted[position] = true;
+        ++segment.deleted_count;
+        if (2 * segment.deleted_count > segment.document_ids.size()) {
+            ScheduleMerge();
+        }
+        return;
+    }
+    corpus_statistics_->RemoveDocument(mutable_segment_->GetWordFrequencies(document_id));
+    mutable_segment_->RemoveDocument(document_id);
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    return corpus_statistics_->GetDocumentCount();
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status,
+                                                         size_t top_k) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus doc_status, int) {
+        return doc_status == status;
+    }, top_k);
+}
+
+SearchServer::MatchDocumentResult SegmentedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    for (const Segment &segment: segments_) {
+        if (segment.FindLive(document_id) >= 0) {
+            return segment.index->MatchDocument(raw_query, document_id);
+        }
+    }
+    // Отсутствующий документ - та же ошибка, что у SearchServer
+    return mutable_segment_->MatchDocument(raw_query, document_id);
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    return segments_.size() + 1;
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    CompleteMerge(true);
+}
+
+unique_ptr<SearchServer> SegmentedSearchServer::MakeIndex() const {
+    auto index = make_unique<SearchServer>(stop_words_);
+    index->SetCorpusStatistics(corpus_statistics_.get());
+    return index;
+}
+
+void SegmentedSearchServer::SealMutableSegment() {
+    mutable_segment_->CompressPostings();
+    Segment segment;
+    segment.document_ids.assign(mutable_segment_->begin(), mutable_segment_->end());
+    segment.is_deleted.assign(segment.document_ids.size(), false);
+    segment.index = move(mutable_segment_);
+    segments_.push_back(move(segment));
+    mutable_segment_ = MakeIndex();
+    ScheduleMerge();
+}
+
+void SegmentedSearchServer::CompleteMerge(bool wait) {
+    if (!merge_ || (!wait && merge_->result.wait_for(chrono::seconds(0)) != future_status::ready)) {
+        return;
+    }
+    const auto merge = move(merge_);
+    Segment merged = merge->result.get();
+    merged.index->SetCorpusStatistics(corpus_statistics_.get());
+
+    for (size_t i = 0; i < merge->sources.size(); ++i) {
+        const auto source = find_if(segments_.begin(), segments_.end(), [&](const Segment &segment) {
+            return segment.index == merge->sources[i];
+        });
+        // Удаленные во время слияния документы удаляются и из его результата
+        for (size_t position = 0; position < source->document_ids.size(); ++position) {
+            if (source->is_deleted[position] && !merge->sources_deleted[i][position]) {
+                const int merged_position = merged.FindLive(source->document_ids[position]);
+                merged.is_deleted[merged_position] = true;
+                ++merged.deleted_count;
+            }
+        }
+        segments_.erase(source);
+    }
+    if (merged.GetLiveCount() > 0) {
+        segments_.push_back(move(merged));
+    }
+    ScheduleMerge();
+}
+
+void SegmentedSearchServer::ScheduleMerge() {
+    if (merge_) {
+        return;
+    }
+    vector<size_t> chosen;
+    vector<vector<size_t>> levels;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const size_t level = GetLevel(segments_[i].GetLiveCount());
+        if (level >= levels.size()) {
+            levels.resize(level + 1);
+        }
+        levels[level].push_back(i);
+        if (levels[level].size() == options_.merge_factor) {
+            chosen = levels[level];
+            break;
+        }
+    }
+    if (chosen.empty()) {
+        for (size_t i = 0; i < segments_.size(); ++i) {
+            if (2 * segments_[i].deleted_count > segments_[i].document_ids.size()) {
+                chosen.push_back(i);
+                break;
+            }
+        }
+    }
+    if (chosen.empty()) {
+        return;
+    }
+
+    merge_ = make_unique<Merge>();
+    vector<vector<int>> sources_ids;
+    for (const size_t i: chosen) {
+        merge_->sources.push_back(segments_[i].index);
+        merge_->sources_deleted.push_back(segments_[i].is_deleted);
+        sources_ids.push_back(segments_[i].document_ids);
+    }
+    // Исходные сегменты больше не меняются, а их удаления переданы копией
+    merge_->result = async(launch::async, [stop_words = stop_words_, sources = merge_->sources,
+            sources_deleted = merge_->sources_deleted, sources_ids = move(sources_ids)]() {
+        vector<DocumentToAdd> documents;
+        for (size_t i = 0; i < sources.size(); ++i) {
+            for (size_t position = 0; position < sources_ids[i].size(); ++position) {
+                if (!sources_deleted[i][position]) {
+                    documents.push_back(sources[i]->ExportDocument(sources_ids[i][position]));
+                }
+            }
+        }
+        Segment merged;
+        merged.index = make_shared<SearchServer>(stop_words);
+        merged.index->AddDocuments(execution::par, documents);
+        merged.index->CompressPostings();
+        merged.document_ids.assign(merged.index->begin(), merged.index->end());
+        merged.is_deleted.assign(merged.document_ids.size(), false);
+        return merged;
+    });
+}
+
+size_t SegmentedSearchServer::GetLevel(size_t live_count) const {
+    size_t level = 0;
+    for (size_t bound = options_.segment_size * options_.merge_factor; live_count >= bound;
+         bound *= options_.merge_factor) {
+        ++level;
+    }
+    return level;
+}
@@ -0,0 +1,148 @@
+//
+// -------- Поисковой сервер из сегментов ----------
+//
+
+#ifndef SEARCH_SERVER_SEGMENTED_SEARCH_SERVER_H
+#define SEARCH_SERVER_SEGMENTED_SEARCH_SERVER_H
+
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "corpus_statistics.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+struct SegmentedSearchServerOptions {
+    // Изменяемый сегмент замораживается, набрав столько документов
+    size_t segment_size = 10000;
+    // Сливаются merge_factor сегментов одного уровня: уровень k - от segment_size * merge_factor^k
+    // до segment_size * merge_factor^(k+1) живых документов
+    size_t merge_factor = 4;
+};
+
+// Индекс из небольшого изменяемого сегмента и неизменяемых сегментов со сжатыми вхождениями (LSM).
+// Новые документы попадают в изменяемый сегмент, который, набрав segment_size документов, замораживается.
+// Удаление из неизменяемого сегмента только отмечает документ в битовой карте сегмента.
+//
+// Фоновое слияние собирает сегменты одного уровня (и сегменты, в которых удалено больше половины
+// документов) в новый сегмент без удаленных документов. Готовый результат подменяет исходные сегменты
+// при следующем изменении или в WaitForMerges; удаления, сделанные во время слияния, переносятся в него.
+//
+// Поиск идет по всем сегментам, IDF считается по статистике всего корпуса, поэтому
+// релевантность совпадает с релевантностью одного сервера с теми же документами
+// (с точностью до EPSILON - слова суммируются в другом порядке).
+//
+// Методы вызываются из одного потока, фоновое слияние работает только с неизменяемыми сегментами.
+class SegmentedSearchServer {
+public:
+    explicit SegmentedSearchServer(std::string_view stop_words, SegmentedSearchServerOptions options = {});
+
+    SegmentedSearchServer(const SegmentedSearchServer &) = delete;
+
+    SegmentedSearchServer &operator=(const SegmentedSearchServer &) = delete;
+
+    ~SegmentedSearchServer();
+
+    void
+    AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    [[nodiscard]] int GetDocumentCount() const;
+
+    template<typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template<typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    [[nodiscard]] std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                     size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    [[nodiscard]] SearchServer::MatchDocumentResult MatchDocument(std::string_view raw_query, int document_id) const;
+
+    // Число сегментов, включая изменяемый
+    [[nodiscard]] size_t GetSegmentCount() const;
+
+    // Дожидается фонового слияния и подставляет его результат
+    void WaitForMerges();
+
+private:
+    struct Segment {
+        std::shared_ptr<SearchServer> index;
+        // Отсортированы по возрастанию
+        std::vector<int> document_ids;
+        // Индекс в векторе - номер документа в document_ids
+        std::vector<bool> is_deleted;
+        size_t deleted_count = 0;
+
+        [[nodiscard]] size_t GetLiveCount() const { return document_ids.size() - deleted_count; }
+
+        // Номер живого документа в document_ids или -1
+        [[nodiscard]] int FindLive(int document_id) const;
+    };
+
+    struct Merge {
+        // Индексы исходных сегментов и их удаления на момент начала слияния
+        std::vector<std::shared_ptr<SearchServer>> sources;
+        std::vector<std::vector<bool>> sources_deleted;
+        std::future<Segment> result;
+    };
+
+    std::string stop_words_;
+    SegmentedSearchServerOptions options_;
+    // Статистика по живым документам всех сегментов. В unique_ptr, чтобы адрес,
+    // сохраненный в сегментах, не зависел от перемещения сервера
+    std::unique_ptr<CorpusStatistics> corpus_statistics_;
+    std::unordered_set<int> document_ids_;
+    std::unique_ptr<SearchServer> mutable_segment_;
+    std::vector<Segment> segments_;
+    std::unique_ptr<Merge> merge_;
+
+    [[nodiscard]] std::unique_ptr<SearchServer> MakeIndex() const;
+
+    void SealMutableSegment();
+
+    // Подставляет результат слияния, если он готов или если wait
+    void CompleteMerge(bool wait);
+
+    void ScheduleMerge();
+
+    [[nodiscard]] size_t GetLevel(size_t live_count) const;
+};
+
+template<typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document>
+SegmentedSearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                        DocumentPredicate document_predicate, size_t top_k) const {
+    // Лучшие документы каждого сегмента уже посчитаны с общим IDF, поэтому их можно сравнивать между собой
+    TopDocuments top_documents(top_k);
+    for (const auto &document: mutable_segment_->FindTopDocuments(policy, raw_query, document_predicate, top_k)) {
+        top_documents.Add(document);
+    }
+    for (const Segment &segment: segments_) {
+        const auto is_live = [&segment, &document_predicate](int document_id, DocumentStatus status, int rating) {
+            return segment.FindLive(document_id) >= 0 && document_predicate(document_id, status, rating);
+        };
+        for (const auto &document: segment.index->FindTopDocuments(policy, raw_query, is_live, top_k)) {
+            top_documents.Add(document);
+        }
+    }
+    return top_documents.Build();
+}
+
+template<typename DocumentPredicate>
+std::vector<Document>
+SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                        size_t top_k) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+}
+
+#endif //SEARCH_SERVER_SEGMENTED_SEARCH_SERVER_H
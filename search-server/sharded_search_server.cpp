@@ -0,0 +1,451 @@
+//
+// -------- Поисковой сервер из процессов-шардов ----------
+//
+
+#include "sharded_search_server.h"
+
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include "top_documents.h"
+
+#ifdef SEARCH_SERVER_PROCESS_SHARDS
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+enum class ShardOperation : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+    FIND_TOP_DOCUMENTS = 3,
+    MATCH_DOCUMENT = 4,
+};
+
+// Первый байт ответа шарда; при ошибке за ним идет текст исключения
+enum class ShardResult : uint8_t {
+    OK = 0,
+    INVALID_ARGUMENT = 1,
+    OUT_OF_RANGE = 2,
+    ERROR = 3,
+};
+
+template<typename Number>
+static void PutNumber(string &out, Number value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void PutString(string &out, string_view value) {
+    PutNumber(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+// Читает число из начала in и сдвигает in
+template<typename Number>
+static Number GetNumber(string_view &in) {
+    Number value;
+    if (in.size() < sizeof(value)) {
+        throw runtime_error("Malformed shard message.");
+    }
+    memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return value;
+}
+
+static string_view GetString(string_view &in) {
+    const auto size = GetNumber<uint32_t>(in);
+    if (in.size() < size) {
+        throw runtime_error("Malformed shard message.");
+    }
+    const string_view value = in.substr(0, size);
+    in.remove_prefix(size);
+    return value;
+}
+
+static void PutWords(string &out, const map<string_view, double> &word_frequencies) {
+    PutNumber(out, static_cast<uint32_t>(word_frequencies.size()));
+    for (const auto &[word, term_freq]: word_frequencies) {
+        PutString(out, word);
+    }
+}
+
+// Слова документа как частоты для CorpusStatistics; сами частоты статистике не нужны
+static map<string_view, double> GetWords(string_view &in) {
+    map<string_view, double> words;
+    const auto count = GetNumber<uint32_t>(in);
+    for (uint32_t i = 0; i < count; ++i) {
+        words.emplace(GetString(in), 0);
+    }
+    return words;
+}
+
+#ifdef SEARCH_SERVER_PROCESS_SHARDS
+
+// Сообщение: длина и содержимое
+static void SendMessage(int socket, const string &payload) {
+    string message;
+    PutNumber(message, static_cast<uint32_t>(payload.size()));
+    message += payload;
+    for (size_t sent = 0; sent < message.size();) {
+        const ssize_t result = send(socket, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (result < 0) {
+            throw runtime_error("Can't send message to shard.");
+        }
+        sent += static_cast<size_t>(result);
+    }
+}
+
+// Возвращает false, если сокет закрыт другой стороной до начала сообщения
+static bool ReceiveExactly(int socket, char *data, size_t size, bool allow_end) {
+    for (size_t received = 0; received < size;) {
+        const ssize_t result = recv(socket, data + received, size - received, 0);
+        if (result == 0 && received == 0 && allow_end) {
+            return false;
+        }
+        if (result <= 0) {
+            throw runtime_error("Can't receive message from shard.");
+        }
+        received += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+static bool ReceiveMessage(int socket, string &payload, bool allow_end = false) {
+    uint32_t size;
+    if (!ReceiveExactly(socket, reinterpret_cast<char *>(&size), sizeof(size), allow_end)) {
+        return false;
+    }
+    payload.resize(size);
+    ReceiveExactly(socket, payload.data(), size, false);
+    return true;
+}
+
+#endif
+
+// Содержимое успешного ответа; ошибка шарда бросается с тем же типом и текстом
+static string ParseResponse(const string &response) {
+    string_view in = response;
+    const auto result = static_cast<ShardResult>(GetNumber<uint8_t>(in));
+    if (result == ShardResult::OK) {
+        return response.substr(1);
+    }
+    const string message(GetString(in));
+    if (result == ShardResult::INVALID_ARGUMENT) {
+        throw invalid_argument(message);
+    }
+    if (result == ShardResult::OUT_OF_RANGE) {
+        throw out_of_range(message);
+    }
+    throw runtime_error(message);
+}
+
+static string HandleRequest(SearchServer &search_server, string_view request) {
+    string response;
+    PutNumber(response, static_cast<uint8_t>(ShardResult::OK));
+    switch (static_cast<ShardOperation>(GetNumber<uint8_t>(request))) {
+        case ShardOperation::ADD_DOCUMENT: {
+            const auto document_id = GetNumber<int32_t>(request);
+            const auto status = static_cast<DocumentStatus>(GetNumber<int32_t>(request));
+            vector<int> ratings(GetNumber<uint32_t>(request));
+            for (int &rating: ratings) {
+                rating = GetNumber<int32_t>(request);
+            }
+            search_server.AddDocument(document_id, GetString(request), status, ratings);
+            PutWords(response, search_server.GetWordFrequencies(document_id));
+            break;
+        }
+        case ShardOperation::REMOVE_DOCUMENT: {
+            const auto document_id = GetNumber<int32_t>(request);
+            PutWords(response, search_server.GetWordFrequencies(document_id));
+            search_server.RemoveDocument(document_id);
+            break;
+        }
+        case ShardOperation::FIND_TOP_DOCUMENTS: {
+            const string_view raw_query = GetString(request);
+            const auto status = static_cast<DocumentStatus>(GetNumber<int32_t>(request));
+            const auto top_k = GetNumber<uint64_t>(request);
+            const auto document_count = GetNumber<int32_t>(request);
+            vector<pair<string_view, size_t>> document_freqs(GetNumber<uint32_t>(request));
+            for (auto &[word, document_freq]: document_freqs) {
+                word = GetString(request);
+                document_freq = GetNumber<uint64_t>(request);
+            }
+            // IDF считается по статистике всего корпуса, пришедшей от координатора
+            const CorpusStatistics corpus_statistics(document_count, document_freqs);
+            search_server.SetCorpusStatistics(&corpus_statistics);
+            vector<Document> documents;
+            try {
+                documents = search_server.FindTopDocuments(raw_query, status, top_k);
+            } catch (...) {
+                search_server.SetCorpusStatistics(nullptr);
+                throw;
+            }
+            search_server.SetCorpusStatistics(nullptr);
+            PutNumber(response, static_cast<uint32_t>(documents.size()));
+            for (const Document &document: documents) {
+                PutNumber(response, static_cast<int32_t>(document.id));
+                PutNumber(response, document.relevance);
+                PutNumber(response, static_cast<int32_t>(document.rating));
+            }
+            break;
+        }
+        case ShardOperation::MATCH_DOCUMENT: {
+            const string_view raw_query = GetString(request);
+            const auto document_id = GetNumber<int32_t>(request);
+            const auto [words, status] = search_server.MatchDocument(raw_query, document_id);
+            PutNumber(response, static_cast<int32_t>(status));
+            PutNumber(response, static_cast<uint32_t>(words.size()));
+            for (const string_view word: words) {
+                PutString(response, word);
+            }
+            break;
+        }
+        default:
+            throw runtime_error("Unknown shard operation.");
+    }
+    return response;
+}
+
+static string MakeErrorResponse(ShardResult result, const char *message) {
+    string response;
+    PutNumber(response, static_cast<uint8_t>(result));
+    PutString(response, message);
+    return response;
+}
+
+// Ответ шарда на запрос, в том числе на ошибочный
+static string ProcessRequest(SearchServer &search_server, string_view request) {
+    try {
+        return HandleRequest(search_server, request);
+    } catch (const invalid_argument &e) {
+        return MakeErrorResponse(ShardResult::INVALID_ARGUMENT, e.what());
+    } catch (const out_of_range &e) {
+        return MakeErrorResponse(ShardResult::OUT_OF_RANGE, e.what());
+    } catch (const exception &e) {
+        return MakeErrorResponse(ShardResult::ERROR, e.what());
+    }
+}
+
+#ifdef SEARCH_SERVER_PROCESS_SHARDS
+
+// Цикл процесса шарда: до закрытия сокета координатором
+static void RunShard(int socket, string_view stop_words) {
+    SearchServer search_server(stop_words);
+    // Рабочих потоков общего планировщика в процессе шарда нет: fork копирует только вызвавший поток
+    TaskScheduler task_scheduler({1});
+    search_server.SetTaskScheduler(task_scheduler);
+    string request;
+    while (ReceiveMessage(socket, request, true)) {
+        SendMessage(socket, ProcessRequest(search_server, request));
+    }
+}
+
+#endif
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, string_view stop_words) {
+    if (shard_count == 0) {
+        throw invalid_argument("Shard count must be positive.");
+    }
+    // Некорректные стоп-слова отклоняются до запуска шардов
+    { [[maybe_unused]] const SearchServer search_server(stop_words); }
+
+#ifndef SEARCH_SERVER_PROCESS_SHARDS
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back({make_unique<SearchServer>(stop_words), {}});
+    }
+#else
+    // Координатор может быть уже многопоточным, а шард после fork не должен ждать блокировок,
+    // которые держали другие потоки. Поэтому общий планировщик создается до fork (его статическая
+    // инициализация в шарде иначе запустила бы потоки или ждала бы чужой инициализации), а сокеты
+    // получают FD_CLOEXEC и не попадают в программы, запущенные другими потоками через fork и exec
+    TaskScheduler::GetDefault();
+    try {
+        for (size_t i = 0; i < shard_count; ++i) {
+            int sockets[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) {
+                throw runtime_error("Can't create shard socket.");
+            }
+            const pid_t pid = fork();
+            if (pid < 0) {
+                close(sockets[0]);
+                close(sockets[1]);
+                throw runtime_error("Can't start shard process.");
+            }
+            if (pid == 0) {
+                // Сокеты других шардов закрываются, чтобы те видели закрытие координатора
+                close(sockets[0]);
+                for (const Shard &shard: shards_) {
+                    close(shard.socket);
+                }
+                int exit_code = 0;
+                try {
+                    RunShard(sockets[1], stop_words);
+                } catch (...) {
+                    exit_code = 1;
+                }
+                // _exit не вызывает деструкторы и не сбрасывает буферы, унаследованные от координатора
+                _exit(exit_code);
+            }
+            close(sockets[1]);
+            shards_.push_back({pid, sockets[0]});
+        }
+    } catch (...) {
+        StopShards();
+        throw;
+    }
+#endif
+}
+
+ShardedSearchServer::~ShardedSearchServer() {
+    StopShards();
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                      const vector<int> &ratings) {
+    if (document_id < 0) throw invalid_argument("Document ID must be a natural number.");
+    if (document_ids_.count(document_id) > 0) throw invalid_argument("Document with this ID already exists.");
+
+    string request;
+    PutNumber(request, static_cast<uint8_t>(ShardOperation::ADD_DOCUMENT));
+    PutNumber(request, static_cast<int32_t>(document_id));
+    PutNumber(request, static_cast<int32_t>(status));
+    PutNumber(request, static_cast<uint32_t>(ratings.size()));
+    for (const int rating: ratings) {
+        PutNumber(request, static_cast<int32_t>(rating));
+    }
+    PutString(request, document);
+
+    const Shard &shard = GetShard(document_id);
+    SendRequest(shard, request);
+    const string response = ReceiveResponse(shard);
+    string_view in = response;
+    corpus_statistics_.AddDocument(GetWords(in));
+    document_ids_.insert(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_ids_.erase(document_id) == 0) {
+        return;
+    }
+    string request;
+    PutNumber(request, static_cast<uint8_t>(ShardOperation::REMOVE_DOCUMENT));
+    PutNumber(request, static_cast<int32_t>(document_id));
+
+    const Shard &shard = GetShard(document_id);
+    SendRequest(shard, request);
+    const string response = ReceiveResponse(shard);
+    string_view in = response;
+    corpus_statistics_.RemoveDocument(GetWords(in));
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    return corpus_statistics_.GetDocumentCount();
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status,
+                                                       size_t top_k) const {
+    // Шардам нужна статистика всех слов запроса; слова проверяются здесь же, как в SearchServer
+    map<string_view, size_t> document_freqs;
+    ForEachWord(raw_query, [this, &document_freqs](string_view word, bool is_valid_word) {
+        const QueryToken token = ParseQueryToken(word, is_valid_word);
+        document_freqs.emplace(token.data, corpus_statistics_.GetDocumentFrequency(token.data));
+    });
+
+    string request;
+    PutNumber(request, static_cast<uint8_t>(ShardOperation::FIND_TOP_DOCUMENTS));
+    PutString(request, raw_query);
+    PutNumber(request, static_cast<int32_t>(status));
+    PutNumber(request, static_cast<uint64_t>(top_k));
+    PutNumber(request, static_cast<int32_t>(corpus_statistics_.GetDocumentCount()));
+    PutNumber(request, static_cast<uint32_t>(document_freqs.size()));
+    for (const auto &[word, document_freq]: document_freqs) {
+        PutString(request, word);
+        PutNumber(request, static_cast<uint64_t>(document_freq));
+    }
+
+    // Сначала запрос уходит всем шардам, чтобы они искали одновременно
+    for (const Shard &shard: shards_) {
+        SendRequest(shard, request);
+    }
+    // Ответы читаются все, даже после ошибки, иначе непрочитанный ответ достанется следующему запросу
+    TopDocuments top_documents(top_k);
+    exception_ptr error;
+    for (const Shard &shard: shards_) {
+        try {
+            const string response = ReceiveResponse(shard);
+            string_view in = response;
+            const auto count = GetNumber<uint32_t>(in);
+            for (uint32_t i = 0; i < count; ++i) {
+                const auto document_id = GetNumber<int32_t>(in);
+                const auto relevance = GetNumber<double>(in);
+                const auto rating = GetNumber<int32_t>(in);
+                top_documents.Add(Document(document_id, relevance, rating));
+            }
+        } catch (...) {
+            if (!error) {
+                error = current_exception();
+            }
+        }
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+    return top_documents.Build();
+}
+
+ShardedSearchServer::MatchDocumentResult ShardedSearchServer::MatchDocument(string_view raw_query,
+                                                                           int document_id) const {
+    if (document_ids_.count(document_id) == 0) throw out_of_range("A nonexistent document_id was passed.");
+
+    string request;
+    PutNumber(request, static_cast<uint8_t>(ShardOperation::MATCH_DOCUMENT));
+    PutString(request, raw_query);
+    PutNumber(request, static_cast<int32_t>(document_id));
+
+    const Shard &shard = GetShard(document_id);
+    SendRequest(shard, request);
+    const string response = ReceiveResponse(shard);
+    string_view in = response;
+    const auto status = static_cast<DocumentStatus>(GetNumber<int32_t>(in));
+    vector<string> words(GetNumber<uint32_t>(in));
+    for (string &word: words) {
+        word = GetString(in);
+    }
+    return {words, status};
+}
+
+const ShardedSearchServer::Shard &ShardedSearchServer::GetShard(int document_id) const {
+    return shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
+
+void ShardedSearchServer::SendRequest(const Shard &shard, const string &request) {
+#ifdef SEARCH_SERVER_PROCESS_SHARDS
+    SendMessage(shard.socket, request);
+#else
+    shard.response = ProcessRequest(*shard.search_server, request);
+#endif
+}
+
+string ShardedSearchServer::ReceiveResponse(const Shard &shard) {
+#ifdef SEARCH_SERVER_PROCESS_SHARDS
+    string response;
+    ReceiveMessage(shard.socket, response);
+#else
+    const string response = move(shard.response);
+#endif
+    return ParseResponse(response);
+}
+
+void ShardedSearchServer::StopShards() {
+#ifdef SEARCH_SERVER_PROCESS_SHARDS
+    for (const Shard &shard: shards_) {
+        close(shard.socket);
+    }
+    for (const Shard &shard: shards_) {
+        waitpid(shard.pid, nullptr, 0);
+    }
+#endif
+    shards_.clear();
+}
@@ -0,0 +1,95 @@
+//
+// -------- Поисковой сервер из процессов-шардов ----------
+//
+
+#ifndef SEARCH_SERVER_SHARDED_SEARCH_SERVER_H
+#define SEARCH_SERVER_SHARDED_SEARCH_SERVER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+#include "corpus_statistics.h"
+#include "search_server.h"
+
+// Шарды - отдельные процессы только там, где есть fork и пары сокетов
+#ifdef __linux__
+#define SEARCH_SERVER_PROCESS_SHARDS
+#include <sys/types.h>
+#endif
+
+// Координатор шардов: документы делятся по id между shard_count дочерними процессами,
+// в каждом свой SearchServer (документ id лежит в шарде id % shard_count). С процессами
+// координатор общается сообщениями через пары сокетов.
+//
+// Запрос рассылается всем шардам сразу, и они ищут параллельно; лучшие документы шардов
+// объединяются в том же порядке, что у SearchServer. Статистику корпуса (число документов
+// и документную частоту слов) ведет координатор и передает шардам вместе с запросом,
+// поэтому выдача совпадает с выдачей одного сервера с теми же документами
+// (релевантность - с точностью до EPSILON).
+//
+// Ошибки шарда передаются координатору и бросаются из его методов с тем же типом и текстом.
+// Процессы создаются через fork, в том числе из многопоточного процесса, поэтому шард использует
+// только последовательные алгоритмы и свой планировщик без рабочих потоков.
+// На системах без fork (Windows) шарды - серверы в процессе координатора: они обмениваются
+// с ним теми же сообщениями, но обрабатывают запрос по очереди, а выдача остается прежней.
+// Методы вызываются из одного потока.
+class ShardedSearchServer {
+public:
+    using MatchDocumentResult = std::tuple<std::vector<std::string>, DocumentStatus>;
+
+    ShardedSearchServer(size_t shard_count, std::string_view stop_words);
+
+    ShardedSearchServer(const ShardedSearchServer &) = delete;
+
+    ShardedSearchServer &operator=(const ShardedSearchServer &) = delete;
+
+    // Завершает процессы шардов
+    ~ShardedSearchServer();
+
+    void
+    AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    [[nodiscard]] int GetDocumentCount() const;
+
+    [[nodiscard]] std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                     size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    [[nodiscard]] MatchDocumentResult MatchDocument(std::string_view raw_query, int document_id) const;
+
+    [[nodiscard]] size_t GetShardCount() const { return shards_.size(); }
+
+private:
+    struct Shard {
+#ifdef SEARCH_SERVER_PROCESS_SHARDS
+        pid_t pid;
+        // Конец пары сокетов на стороне координатора
+        int socket;
+#else
+        std::unique_ptr<SearchServer> search_server;
+        // Ответ на отправленный запрос, который координатор еще не прочитал
+        mutable std::string response;
+#endif
+    };
+
+    std::vector<Shard> shards_;
+    CorpusStatistics corpus_statistics_;
+    std::unordered_set<int> document_ids_;
+
+    [[nodiscard]] const Shard &GetShard(int document_id) const;
+
+    static void SendRequest(const Shard &shard, const std::string &request);
+
+    // Содержимое успешного ответа; ошибка шарда бросается с тем же типом и текстом
+    static std::string ReceiveResponse(const Shard &shard);
+
+    // Закрывает сокеты и дожидается завершения процессов
+    void StopShards();
+};
+
+#endif //SEARCH_SERVER_SHARDED_SEARCH_SERVER_H
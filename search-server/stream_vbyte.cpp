@@ -0,0 +1,162 @@
+//
+// -------- Сжатие целых чисел (Stream VByte) ----------
+//
+
+#include "stream_vbyte.h"
+
+#include <array>
+
+// Перестановка байтов SSSE3 не входит в базовый набор x86-64, поэтому декодер с ней собирается
+// с атрибутом target и выбирается при запуске, если процессор его поддерживает.
+// Префиксная сумма обходится SSE2, который есть на любом x86-64.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STREAM_VBYTE_SIMD 1
+#include <immintrin.h>
+#else
+#define STREAM_VBYTE_SIMD 0
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+static int GetByteLength(uint32_t value) {
+    if (value < (1U << 8)) return 1;
+    if (value < (1U << 16)) return 2;
+    if (value < (1U << 24)) return 3;
+    return 4;
+}
+
+void EncodeStreamVByte(const uint32_t *values, size_t count, vector<uint8_t> &out) {
+    const size_t control_offset = out.size();
+    out.resize(out.size() + (count + 3) / 4, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const int length = GetByteLength(values[i]);
+        out[control_offset + i / 4] |= static_cast<uint8_t>((length - 1) << (2 * (i % 4)));
+        for (int byte = 0; byte < length; ++byte) {
+            out.push_back(static_cast<uint8_t>(values[i] >> (8 * byte)));
+        }
+    }
+}
+
+size_t GetStreamVByteSize(const uint8_t *in, size_t count) {
+    // Управляющие байты и по байту на число, к которому прибавляется длина сверх первого байта
+    size_t size = (count + 3) / 4 + count;
+    for (size_t i = 0; i < count; ++i) {
+        size += (in[i / 4] >> (2 * (i % 4))) & 3;
+    }
+    return size;
+}
+
+static const uint8_t *DecodeScalar(const uint8_t *control, const uint8_t *data, size_t count, uint32_t *values) {
+    for (size_t i = 0; i < count; ++i) {
+        const int length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (int byte = 0; byte < length; ++byte) {
+            value |= static_cast<uint32_t>(data[byte]) << (8 * byte);
+        }
+        values[i] = value;
+        data += length;
+    }
+    return data;
+}
+
+const uint8_t *DecodeStreamVByteScalar(const uint8_t *in, size_t count, uint32_t *values) {
+    return DecodeScalar(in, in + (count + 3) / 4, count, values);
+}
+
+#if STREAM_VBYTE_SIMD
+
+struct ShuffleTable {
+    // Для каждого управляющего байта: маска перестановки 16 байт данных в 4 числа и число прочитанных байт
+    array<array<uint8_t, 16>, 256> masks;
+    array<uint8_t, 256> lengths;
+
+    ShuffleTable() {
+        for (int control = 0; control < 256; ++control) {
+            uint8_t offset = 0;
+            for (int i = 0; i < 4; ++i) {
+                const int length = ((control >> (2 * i)) & 3) + 1;
+                for (int byte = 0; byte < 4; ++byte) {
+                    masks[control][4 * i + byte] = byte < length ? offset + byte : 0x80;
+                }
+                offset += length;
+            }
+            lengths[control] = offset;
+        }
+    }
+};
+
+static const ShuffleTable SHUFFLE_TABLE;
+
+__attribute__((target("ssse3")))
+static const uint8_t *DecodeSsse3(const uint8_t *in, size_t count, uint32_t *values) {
+    const uint8_t *control = in;
+    const uint8_t *data = in + (count + 3) / 4;
+    // Полные четверки декодируются перестановкой, последняя неполная - по одному числу
+    const size_t full_groups = count / 4;
+    for (size_t group = 0; group < full_groups; ++group) {
+        const uint8_t code = control[group];
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(SHUFFLE_TABLE.masks[code].data()));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(values + 4 * group), _mm_shuffle_epi8(bytes, mask));
+        data += SHUFFLE_TABLE.lengths[code];
+    }
+    return DecodeScalar(control + full_groups, data, count - 4 * full_groups, values + 4 * full_groups);
+}
+
+bool IsStreamVByteSimdSupported() {
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+
+const uint8_t *DecodeStreamVByte(const uint8_t *in, size_t count, uint32_t *values) {
+    static const auto decode = IsStreamVByteSimdSupported() ? DecodeSsse3 : DecodeStreamVByteScalar;
+    return decode(in, count, values);
+}
+
+#else
+
+bool IsStreamVByteSimdSupported() {
+    return false;
+}
+
+const uint8_t *DecodeStreamVByte(const uint8_t *in, size_t count, uint32_t *values) {
+    return DecodeStreamVByteScalar(in, count, values);
+}
+
+#endif
+
+#if defined(__SSE2__)
+
+void PrefixSumDeltas(uint32_t *values, size_t count, uint32_t base) {
+    __m128i previous = _mm_set1_epi32(static_cast<int>(base));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+        current = _mm_add_epi32(current, _mm_slli_si128(current, 4));
+        current = _mm_add_epi32(current, _mm_slli_si128(current, 8));
+        current = _mm_add_epi32(current, previous);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), current);
+        previous = _mm_shuffle_epi32(current, 0xFF);
+    }
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(previous));
+    for (; i < count; ++i) {
+        sum += values[i];
+        values[i] = sum;
+    }
+}
+
+#else
+
+void PrefixSumDeltas(uint32_t *values, size_t count, uint32_t base) {
+    uint32_t sum = base;
+    for (size_t i = 0; i < count; ++i) {
+        sum += values[i];
+        values[i] = sum;
+    }
+}
+
+#endif
@@ -0,0 +1,38 @@
+//
+// -------- Сжатие целых чисел (Stream VByte) ----------
+//
+
+#ifndef SEARCH_SERVER_STREAM_VBYTE_H
+#define SEARCH_SERVER_STREAM_VBYTE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Формат Stream VByte: сначала по 2 бита длины (1-4 байта) на каждое число, упакованные
+// по 4 в управляющий байт, затем значащие байты самих чисел. Раздельное хранение длин
+// позволяет декодировать 4 числа одной перестановкой байтов SSSE3 (pshufb).
+
+// Сколько байт может прочитать декодер за концом закодированных данных.
+// Буфер с закодированными данными нужно дополнить таким числом байт.
+const size_t STREAM_VBYTE_PADDING = 16;
+
+void EncodeStreamVByte(const uint32_t *values, size_t count, std::vector<uint8_t> &out);
+
+// Декодирует count чисел и возвращает указатель на первый байт после закодированных данных.
+// Перестановкой SSSE3 пользуется, только если ее поддерживает процессор (см. IsStreamVByteSimdSupported).
+const uint8_t *DecodeStreamVByte(const uint8_t *in, size_t count, uint32_t *values);
+
+// То же по одному числу, без SIMD
+const uint8_t *DecodeStreamVByteScalar(const uint8_t *in, size_t count, uint32_t *values);
+
+// Декодирует ли DecodeStreamVByte перестановкой SSSE3 на этом процессоре
+bool IsStreamVByteSimdSupported();
+
+// Число байт, которое занимают count закодированных чисел, начиная с in
+size_t GetStreamVByteSize(const uint8_t *in, size_t count);
+
+// Превращает разности в значения: values[i] = base + values[0] + ... + values[i]
+void PrefixSumDeltas(uint32_t *values, size_t count, uint32_t base);
+
+#endif //SEARCH_SERVER_STREAM_VBYTE_H
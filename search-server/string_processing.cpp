@@ -4,18 +4,104 @@
 
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(std::string_view str) {
-    std::vector<std::string_view> result;
-    str.remove_prefix(std::min(str.find_first_not_of(" "), str.size()));
-    while (!str.empty()) {
-        int64_t space = str.find(' ');
-        result.push_back(str.substr(0, space));
-        if (str.find(' ') != str.npos) {
-            str.remove_prefix(space);
-            str.remove_prefix(std::min(str.find_first_not_of(" "), str.size()));
-        } else {
-            str.remove_prefix(str.size());
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Маски ровно WORD_MASK_BLOCK_SIZE байт data
+static void ComputeFullWordMasks(const char *data, uint64_t &spaces, uint64_t &controls) {
+    spaces = 0;
+    controls = 0;
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    for (size_t i = 0; i < WORD_MASK_BLOCK_SIZE; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        // Управляющий символ: 0 <= c < ' ' в знаковых байтах
+        const __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(space, bytes),
+                                                 _mm256_cmpgt_epi8(bytes, minus_one));
+        spaces |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)))) << i;
+        controls |= uint64_t(uint32_t(_mm256_movemask_epi8(control))) << i;
+    }
+#elif defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    for (size_t i = 0; i < WORD_MASK_BLOCK_SIZE; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        // Управляющий символ: 0 <= c < ' ' в знаковых байтах
+        const __m128i control = _mm_and_si128(_mm_cmplt_epi8(bytes, space), _mm_cmpgt_epi8(bytes, minus_one));
+        spaces |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space))) << i;
+        controls |= uint64_t(_mm_movemask_epi8(control)) << i;
+    }
+#else
+    for (size_t i = 0; i < WORD_MASK_BLOCK_SIZE; ++i) {
+        spaces |= uint64_t(data[i] == ' ') << i;
+        controls |= uint64_t(data[i] >= '\0' && data[i] < ' ') << i;
+    }
+#endif
+}
+
+void ComputeWordMasks(const char *data, size_t size, uint64_t &spaces, uint64_t &controls) {
+    if (size >= WORD_MASK_BLOCK_SIZE) {
+        ComputeFullWordMasks(data, spaces, controls);
+        return;
+    }
+    // Неполный блок дополняется пробелами, чтобы не читать за концом текста
+    char block[WORD_MASK_BLOCK_SIZE];
+    std::fill(std::copy(data, data + size, block), block + WORD_MASK_BLOCK_SIZE, ' ');
+    ComputeFullWordMasks(block, spaces, controls);
+}
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text) {
+    std::vector<std::string_view> words;
+    SplitIntoWords(text, words);
+    return words;
+}
+
+void SplitIntoWords(std::string_view text, std::vector<std::string_view> &words) {
+    words.clear();
+    ForEachWord(text, [&words](std::string_view word, bool) {
+        words.push_back(word);
+    });
+}
+
+bool IsValidWord(std::string_view word) {
+    // A valid word must not contain special characters
+    size_t base = 0;
+    for (; base + WORD_MASK_BLOCK_SIZE <= word.size(); base += WORD_MASK_BLOCK_SIZE) {
+        uint64_t spaces, controls;
+        ComputeWordMasks(word.data() + base, WORD_MASK_BLOCK_SIZE, spaces, controls);
+        if (controls != 0) {
+            return false;
         }
     }
-    return result;
-}
\ No newline at end of file
+    // Обычное слово короче блока, и его дешевле проверить без дополнения до блока
+    return std::none_of(word.begin() + base, word.end(), [](char c) {
+        return c >= '\0' && c < ' ';
+    });
+}
+
+QueryToken ParseQueryToken(std::string_view word) {
+    return ParseQueryToken(word, IsValidWord(word));
+}
+
+QueryToken ParseQueryToken(std::string_view word, bool is_valid_word) {
+    bool is_minus = false;
+    // Word shouldn't be empty
+    if (word[0] == '-') {
+        is_minus = true;
+        word = word.substr(1);
+    }
+    if (word.empty() || !is_valid_word) {
+        throw std::invalid_argument("Query has incorrect symbols in " + std::string(word) + ".");
+    }
+    if (is_minus && word[0] == '-') {
+        throw std::invalid_argument("Query has incorrect minus-words:" + std::string(word) + ".");
+    }
+    return {word, is_minus};
+}
@@ -5,13 +5,43 @@
 #ifndef SEARCH_SERVER_STRING_PROCESSING_H
 #define SEARCH_SERVER_STRING_PROCESSING_H
 
+#include <algorithm>
+#include <cstdint>
 #include <set>
 #include <string>
 #include <vector>
 
+// Текст разбирается блоками по WORD_MASK_BLOCK_SIZE байт
+const size_t WORD_MASK_BLOCK_SIZE = 64;
+
+// Битовые маски блока: бит i установлен, если data[i] - пробел (spaces) или управляющий символ (controls).
+// Берется не больше size байт, остаток блока считается пробелами. Использует SSE2 или AVX2, если они доступны.
+void ComputeWordMasks(const char *data, size_t size, uint64_t &spaces, uint64_t &controls);
+
+// Передает слова текста, разделенные пробелами, в handler(std::string_view word, bool is_valid_word),
+// где is_valid_word - то же, что IsValidWord(word). Текст проходится один раз и без выделения памяти.
+template<typename Handler>
+void ForEachWord(std::string_view text, Handler handler);
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Заполняет words словами текста, память words переиспользуется между вызовами
+void SplitIntoWords(std::string_view text, std::vector<std::string_view> &words);
+
+// Слово не должно содержать управляющих символов
+bool IsValidWord(std::string_view word);
+
+struct QueryToken {
+    std::string_view data;
+    bool is_minus;
+};
+
+// Отделяет минус от слова запроса и проверяет слово, при ошибке бросает invalid_argument
+QueryToken ParseQueryToken(std::string_view word);
+
+// То же для слова, уже проверенного при разборе текста (см. ForEachWord)
+QueryToken ParseQueryToken(std::string_view word, bool is_valid_word);
+
 using TransparentStringSet = std::set<std::string, std::less<>>;
 
 template <typename StringContainer>
@@ -25,4 +55,43 @@ TransparentStringSet MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     return non_empty_strings;
 }
 
+template<typename Handler>
+void ForEachWord(std::string_view text, Handler handler) {
+    // Начало текущего слова и были ли в нем управляющие символы; слово может продолжаться в следующем блоке
+    size_t word_begin = text.npos;
+    bool has_controls = false;
+    for (size_t base = 0; base < text.size(); base += WORD_MASK_BLOCK_SIZE) {
+        uint64_t spaces, controls;
+        ComputeWordMasks(text.data() + base, std::min(WORD_MASK_BLOCK_SIZE, text.size() - base), spaces, controls);
+        // Байты блока до position уже разобраны
+        size_t position = 0;
+        while (position < WORD_MASK_BLOCK_SIZE) {
+            const uint64_t rest = ~uint64_t(0) << position;
+            if (word_begin == text.npos) {
+                const uint64_t letters = ~spaces & rest;
+                if (letters == 0) {
+                    break;
+                }
+                position = __builtin_ctzll(letters);
+                word_begin = base + position;
+                has_controls = false;
+            } else {
+                const uint64_t word_spaces = spaces & rest;
+                if (word_spaces == 0) {
+                    has_controls |= (controls & rest) != 0;
+                    break;
+                }
+                const size_t word_end = __builtin_ctzll(word_spaces);
+                has_controls |= (controls & rest & ~(~uint64_t(0) << word_end)) != 0;
+                handler(text.substr(word_begin, base + word_end - word_begin), !has_controls);
+                word_begin = text.npos;
+                position = word_end;
+            }
+        }
+    }
+    if (word_begin != text.npos) {
+        handler(text.substr(word_begin), !has_controls);
+    }
+}
+
 #endif //SEARCH_SERVER_STRING_PROCESSING_H
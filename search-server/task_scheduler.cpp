@@ -0,0 +1,176 @@
+//
+// -------- Планировщик задач ----------
+//
+
+#include "task_scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+// Планировщик и очередь, которым принадлежит текущий рабочий поток
+static thread_local const TaskScheduler *current_scheduler = nullptr;
+static thread_local size_t current_queue = 0;
+
+TaskScheduler::TaskScheduler(TaskSchedulerOptions options) {
+    const size_t core_count = max(thread::hardware_concurrency(), 1U);
+    const size_t thread_count = options.thread_count == 0 ? core_count : options.thread_count;
+    const size_t worker_count = thread_count - 1;
+
+    for (size_t i = 0; i <= worker_count; ++i) {
+        queues_.push_back(make_unique<TaskQueue>());
+    }
+    try {
+        workers_.reserve(worker_count);
+        for (size_t i = 0; i < worker_count; ++i) {
+            workers_.emplace_back([this, i] {
+                RunWorker(i);
+            });
+#ifdef __linux__
+            if (options.pin_threads) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET((i + 1) % core_count, &cpus);
+                if (pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpus), &cpus) != 0) {
+                    throw runtime_error("Failed to pin worker thread to CPU.");
+                }
+            }
+#endif
+        }
+    } catch (...) {
+        Stop();
+        throw;
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    Stop();
+}
+
+TaskScheduler &TaskScheduler::GetDefault() {
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+void TaskScheduler::RunChunks(size_t count, ChunkFunction run, void *function) {
+    const size_t chunk_count = min(count, CHUNKS_PER_THREAD * GetThreadCount());
+    TaskGroup group;
+    group.pending_count = chunk_count;
+
+    const size_t queue_index = GetCurrentQueue();
+    {
+        TaskQueue &queue = *queues_[queue_index];
+        lock_guard guard(queue.mutex);
+        queued_task_count_ += chunk_count;
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            queue.tasks.push_back({run, function, count * chunk / chunk_count, count * (chunk + 1) / chunk_count,
+                                   &group});
+        }
+    }
+    {
+        lock_guard guard(wake_mutex_);
+    }
+    wake_.notify_all();
+
+    // Пока части группы не завершены, поток выполняет любые задачи, в том числе чужих групп
+    while (group.pending_count.load() > 0) {
+        if (TryRunTask(queue_index)) {
+            continue;
+        }
+        unique_lock lock(wake_mutex_);
+        wake_.wait(lock, [this, &group] {
+            return group.pending_count.load() == 0 || queued_task_count_.load() > 0;
+        });
+    }
+    if (group.error) {
+        rethrow_exception(group.error);
+    }
+}
+
+void TaskScheduler::RunWorker(size_t worker_index) {
+    current_scheduler = this;
+    current_queue = worker_index;
+    while (true) {
+        if (TryRunTask(worker_index)) {
+            continue;
+        }
+        unique_lock lock(wake_mutex_);
+        wake_.wait(lock, [this] {
+            return stopping_ || queued_task_count_.load() > 0;
+        });
+        if (stopping_ && queued_task_count_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool TaskScheduler::TryRunTask(size_t queue_index) {
+    if (queued_task_count_.load() == 0) {
+        return false;
+    }
+    Task task{};
+    bool found = false;
+    {
+        TaskQueue &queue = *queues_[queue_index];
+        lock_guard guard(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size() && !found; ++i) {
+        TaskQueue &queue = *queues_[(queue_index + i) % queues_.size()];
+        lock_guard guard(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    --queued_task_count_;
+
+    TaskGroup &group = *task.group;
+    try {
+        task.run(task.function, task.first, task.last);
+    } catch (...) {
+        lock_guard guard(group.error_mutex);
+        if (!group.error) {
+            group.error = current_exception();
+        }
+    }
+    // После последней части ждущий поток уничтожает группу, поэтому к ней больше не обращаемся
+    if (group.pending_count.fetch_sub(1) == 1) {
+        {
+            lock_guard guard(wake_mutex_);
+        }
+        wake_.notify_all();
+    }
+    return true;
+}
+
+size_t TaskScheduler::GetCurrentQueue() const {
+    return current_scheduler == this ? current_queue : queues_.size() - 1;
+}
+
+void TaskScheduler::Stop() {
+    {
+        lock_guard guard(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker: workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
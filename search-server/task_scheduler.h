@@ -0,0 +1,117 @@
+//
+// -------- Планировщик задач ----------
+//
+
+#ifndef SEARCH_SERVER_TASK_SCHEDULER_H
+#define SEARCH_SERVER_TASK_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct TaskSchedulerOptions {
+    // Число потоков, выполняющих задачи, вместе с потоком, который вызвал ParallelFor.
+    // 0 - по числу ядер, 1 - рабочих потоков нет, и все выполняется в вызывающем потоке.
+    size_t thread_count = 0;
+    // Закрепить i-й рабочий поток за ядром (i + 1) % число ядер; ядро 0 остается вызывающему потоку.
+    // Поддерживается только в Linux, на других системах потоки не закрепляются.
+    bool pin_threads = false;
+};
+
+// Пул рабочих потоков с перехватом задач. У каждого рабочего потока своя очередь: свои задачи он берет
+// с конца, а свободный поток перехватывает задачи из начала чужих очередей. Задачи потоков не из пула
+// попадают в общую очередь.
+//
+// Поток, ждущий завершения ParallelFor, сам выполняет задачи из очередей. Поэтому вложенный
+// ParallelFor (например, параллельный поиск из ProcessQueries) не блокирует рабочий поток
+// и не создает новых: потоков всегда thread_count.
+class TaskScheduler {
+public:
+    explicit TaskScheduler(TaskSchedulerOptions options = {});
+
+    TaskScheduler(const TaskScheduler &) = delete;
+
+    TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    ~TaskScheduler();
+
+    // Общий планировщик с настройками по умолчанию, по нему работают серверы без своего
+    // (см. SearchServer::SetTaskScheduler)
+    static TaskScheduler &GetDefault();
+
+    [[nodiscard]] size_t GetThreadCount() const { return workers_.size() + 1; }
+
+    // Вызывает function(i) для всех i из [0, count) и возвращается, когда все вызовы завершены.
+    // Индексы делятся на непрерывные части, не больше CHUNKS_PER_THREAD на поток. Исключение прерывает
+    // только свою часть: остальные выполняются до конца, после чего пробрасывается первое исключение.
+    template<typename Function>
+    void ParallelFor(size_t count, Function function);
+
+private:
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    using ChunkFunction = void (*)(void *function, size_t first, size_t last);
+
+    struct TaskGroup {
+        std::atomic<size_t> pending_count = 0;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        ChunkFunction run;
+        void *function;
+        size_t first;
+        size_t last;
+        TaskGroup *group;
+    };
+
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers_;
+    // Очереди рабочих потоков, последняя - общая
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    // Не меньше числа задач в очередях: увеличивается до того, как задача станет видна
+    std::atomic<size_t> queued_task_count_ = 0;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    void RunChunks(size_t count, ChunkFunction run, void *function);
+
+    void RunWorker(size_t worker_index);
+
+    // Выполняет одну задачу: из конца очереди queue_index, иначе из начала любой другой
+    bool TryRunTask(size_t queue_index);
+
+    [[nodiscard]] size_t GetCurrentQueue() const;
+
+    void Stop();
+};
+
+template<typename Function>
+void TaskScheduler::ParallelFor(size_t count, Function function) {
+    if (workers_.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            function(i);
+        }
+        return;
+    }
+    RunChunks(count, [](void *function, size_t first, size_t last) {
+        auto &body = *static_cast<Function *>(function);
+        for (size_t i = first; i < last; ++i) {
+            body(i);
+        }
+    }, &function);
+}
+
+#endif //SEARCH_SERVER_TASK_SCHEDULER_H
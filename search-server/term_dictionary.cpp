@@ -0,0 +1,103 @@
+//
+// -------- Словарь слов ----------
+//
+
+#include "term_dictionary.h"
+
+using namespace std;
+
+static const size_t INITIAL_SLOT_COUNT = 1024;
+
+// FNV-1a
+static uint64_t HashTerm(string_view term) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c: term) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+TermDictionary::TermDictionary() : slots_(INITIAL_SLOT_COUNT, INVALID_TERM_ID) {}
+
+TermId TermDictionary::Intern(string_view term) {
+    const uint64_t hash = HashTerm(term);
+    size_t slot = FindSlot(term, hash);
+    if (slots_[slot] != INVALID_TERM_ID) {
+        return slots_[slot];
+    }
+    if (!free_term_ids_.empty()) {
+        const TermId term_id = free_term_ids_.back();
+        free_term_ids_.pop_back();
+        terms_[term_id] = term;
+        hashes_[term_id] = hash;
+        slots_[slot] = term_id;
+        return term_id;
+    }
+    // Заполненность таблицы держим не выше 1/2
+    if (2 * (terms_.size() + 1) > slots_.size()) {
+        Grow();
+        slot = FindSlot(term, hash);
+    }
+    const auto term_id = static_cast<TermId>(terms_.size());
+    terms_.emplace_back(term);
+    hashes_.push_back(hash);
+    slots_[slot] = term_id;
+    return term_id;
+}
+
+TermId TermDictionary::Find(string_view term) const {
+    return slots_[FindSlot(term, HashTerm(term))];
+}
+
+void TermDictionary::Erase(TermId term_id) {
+    const size_t mask = slots_.size() - 1;
+    size_t hole = FindSlot(GetTerm(term_id), hashes_[term_id]);
+    slots_[hole] = INVALID_TERM_ID;
+    // Надгробия не нужны: следующие элементы цепочки сдвигаются в дыру, если она лежит
+    // между их исходной ячейкой и текущей
+    for (size_t slot = (hole + 1) & mask; slots_[slot] != INVALID_TERM_ID; slot = (slot + 1) & mask) {
+        const size_t home = hashes_[slots_[slot]] & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            slots_[hole] = slots_[slot];
+            slots_[slot] = INVALID_TERM_ID;
+            hole = slot;
+        }
+    }
+    terms_[term_id].clear();
+    terms_[term_id].shrink_to_fit();
+    free_term_ids_.push_back(term_id);
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    size_t memory_usage = terms_.size() * sizeof(string) + hashes_.capacity() * sizeof(uint64_t) +
+                          slots_.capacity() * sizeof(TermId) + free_term_ids_.capacity() * sizeof(TermId);
+    for (const string &term: terms_) {
+        memory_usage += term.capacity();
+    }
+    return memory_usage;
+}
+
+size_t TermDictionary::FindSlot(string_view term, uint64_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const TermId term_id = slots_[slot];
+        if (term_id == INVALID_TERM_ID || (hashes_[term_id] == hash && GetTerm(term_id) == term)) {
+            return slot;
+        }
+    }
+}
+
+// Вызывается, только когда свободных TermId нет, поэтому все TermId заняты словами
+void TermDictionary::Grow() {
+    vector<TermId> slots(slots_.size() * 2, INVALID_TERM_ID);
+    const size_t mask = slots.size() - 1;
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        size_t slot = hashes_[term_id] & mask;
+        while (slots[slot] != INVALID_TERM_ID) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = term_id;
+    }
+    slots_ = move(slots);
+}
@@ -0,0 +1,55 @@
+//
+// -------- Словарь слов ----------
+//
+
+#ifndef SEARCH_SERVER_TERM_DICTIONARY_H
+#define SEARCH_SERVER_TERM_DICTIONARY_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using TermId = uint32_t;
+
+const TermId INVALID_TERM_ID = UINT32_MAX;
+
+// Каждому слову выдается плотный целочисленный TermId (0, 1, 2, ...).
+// Поиск идет по хеш-таблице с открытой адресацией и линейным пробированием,
+// сами слова хранятся в словаре и не зависят от текстов документов.
+// TermId удаленных слов выдаются новым словам повторно, а текст удаленного слова освобождается сразу,
+// поэтому память пропорциональна наибольшему числу одновременно живых слов. string_view из GetTerm
+// действителен, пока слово не удалено: добавление других слов и удаление других слов его не трогают.
+class TermDictionary {
+public:
+    TermDictionary();
+
+    TermId Intern(std::string_view term);
+
+    [[nodiscard]] TermId Find(std::string_view term) const;
+
+    void Erase(TermId term_id);
+
+    [[nodiscard]] std::string_view GetTerm(TermId term_id) const { return terms_[term_id]; }
+
+    // Граница выданных TermId: все TermId меньше size(), включая освобожденные
+    [[nodiscard]] size_t size() const { return terms_.size(); }
+
+    [[nodiscard]] size_t GetMemoryUsage() const;
+
+private:
+    // Текст слова по TermId, у освобожденных TermId - пустой. deque не переносит строки при добавлении,
+    // поэтому короткие слова, которые хранятся внутри самой строки, тоже не меняют адрес
+    std::deque<std::string> terms_;
+    std::vector<uint64_t> hashes_;
+    // Ячейки хранят TermId или INVALID_TERM_ID для пустой ячейки; размер - степень двойки
+    std::vector<TermId> slots_;
+    std::vector<TermId> free_term_ids_;
+
+    [[nodiscard]] size_t FindSlot(std::string_view term, uint64_t hash) const;
+
+    void Grow();
+};
+
+#endif //SEARCH_SERVER_TERM_DICTIONARY_H
@@ -19,6 +19,68 @@ void AssertImpl(bool value, const string &expr_str, const string &file,
     }
 }
 
+void AssertSameDocuments(const vector<Document> &expected, const vector<Document> &actual, double tolerance,
+                         const string &hint) {
+    ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint);
+        ASSERT_HINT(actual[i].relevance == expected[i].relevance ||
+                    abs(actual[i].relevance - expected[i].relevance) < tolerance, hint);
+        ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, hint);
+    }
+}
+
+// Счетчик выделений памяти в текущем потоке: глобальный operator new заменен, чтобы тесты
+// могли проверить, что код не выделяет память. noinline не дает компилятору встроить замену
+// и принять пары malloc/free за несовпадающие new/delete
+static thread_local size_t allocation_count = 0;
+
+__attribute__((noinline)) void *operator new(size_t size) {
+    ++allocation_count;
+    if (void *pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void *pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+// Остальные варианты тоже заменены, иначе память выделенная ими освобождалась бы через free
+__attribute__((noinline)) void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void *operator new(size_t size, const nothrow_t &) noexcept {
+    ++allocation_count;
+    return malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) void *operator new[](size_t size, const nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+
+__attribute__((noinline)) void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete[](void *pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void *pointer, const nothrow_t &) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete[](void *pointer, const nothrow_t &) noexcept {
+    free(pointer);
+}
+
 // -------- Начало модульных тестов поисковой системы ----------
 
 // Тест проверяет, что поисковая система исключает стоп-слова при добавлении
@@ -288,8 +350,10 @@ void TestRemovingDuplicates() {
     AddDocument(search_server, 9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
 
     ASSERT_EQUAL(search_server.GetDocumentCount(), 9);
-    RemoveDuplicates(search_server, false);
+    const vector<int> duplicate_ids = RemoveDuplicates(search_server, false);
     ASSERT_EQUAL(search_server.GetDocumentCount(), 5);
+    ASSERT(duplicate_ids == vector<int>({3, 4, 5, 7}));
+    ASSERT(FindDuplicates(search_server).empty());
 }
 
 void TestProcessQueries() {
@@ -527,9 +591,1810 @@ void StressTestDifferentVersionsFindTopDocuments() {
         cout << total_relevance << endl;
     }
 
+    {
+        SEARCH_SERVER_DURATION;
+        double total_relevance = 0;
+        for (const string_view query: queries) {
+            for (const auto &document: search_server.FindTopDocuments(query_evaluation::max_score, query)) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    }
+
+}
+
+void TestPostingListOrder() {
+    PostingList postings;
+    for (int id: {5, 1, 9, 3, 7}) {
+        postings.Insert(id, static_cast<DocumentSlot>(id), id / 10.0);
+    }
+    ASSERT_EQUAL(postings.size(), 5);
+    int prev_id = -1;
+    for (PostingList::Cursor cursor(postings); !cursor.IsEnd(); cursor.Next()) {
+        ASSERT(prev_id < cursor->document_id);
+        ASSERT(abs(cursor->term_freq - cursor->document_id / 10.0) < EPSILON);
+        prev_id = cursor->document_id;
+    }
+    ASSERT(postings.Erase(3));
+    ASSERT(!postings.Erase(3));
+    ASSERT(!postings.Contains(3));
+    ASSERT(postings.Contains(9));
+    ASSERT_EQUAL(postings.size(), 4);
+
+    // документы добавлены не по порядку id, выдача не должна от этого зависеть
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(4, "curly cat curly tail"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "big cat fancy collar"s, DocumentStatus::ACTUAL, {3});
+    search_server.RemoveDocument(2);
+    const auto found_docs = search_server.FindTopDocuments("curly collar"s);
+    ASSERT_EQUAL(found_docs.size(), 2);
+    ASSERT_EQUAL(found_docs[0].id, 4);
+    ASSERT_EQUAL(found_docs[1].id, 3);
+}
+
+void TestTermDictionary() {
+    TermDictionary terms;
+    ASSERT_EQUAL(terms.Find("cat"s), INVALID_TERM_ID);
+    const TermId cat = terms.Intern("cat"s);
+    ASSERT_EQUAL(terms.Intern("cat"s), cat);
+    ASSERT_EQUAL(terms.Find("cat"s), cat);
+    ASSERT_EQUAL(terms.GetTerm(cat), "cat"s);
+
+    // таблица несколько раз расширяется, выданные id не меняются
+    for (int i = 0; i < 5000; ++i) {
+        ASSERT_EQUAL(terms.Intern("word"s + to_string(i)), static_cast<TermId>(i + 1));
+    }
+    ASSERT_EQUAL(terms.size(), 5001);
+    ASSERT_EQUAL(terms.Find("word4321"s), 4322u);
+    ASSERT_EQUAL(terms.Find("cat"s), cat);
+    ASSERT_EQUAL(terms.Find("dog"s), INVALID_TERM_ID);
+
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    const auto freqs = search_server.GetWordFrequencies(1);
+    ASSERT_EQUAL(freqs.size(), 4);
+    ASSERT(abs(freqs.at("rat"s) - 0.4) < EPSILON);
+    const auto [words, status] = search_server.MatchDocument("rat funny dog -cat"s, 1);
+    ASSERT_EQUAL(words.size(), 2);
+    ASSERT_EQUAL(words[0], "funny"s);
+    ASSERT_EQUAL(words[1], "rat"s);
+
+    // Слова выдачи MatchDocument не меняются, когда TermId удаленных слов достаются новым словам,
+    // а добавление слов расширяет словарь
+    search_server.AddDocument(2, "quick brown fox"s, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocument(2);
+    search_server.AddDocument(3, "zebra yak gnu"s, DocumentStatus::ACTUAL, {1});
+    for (int i = 0; i < 1000; ++i) {
+        search_server.AddDocument(4 + i, "long churning word number "s + to_string(i), DocumentStatus::ACTUAL, {1});
+    }
+    ASSERT_EQUAL(words.size(), 2);
+    ASSERT_EQUAL(words[0], "funny"s);
+    ASSERT_EQUAL(words[1], "rat"s);
+    ASSERT_EQUAL(search_server.GetWordFrequencies(3).count("zebra"s), 1);
+
+    // При смене словаря память словаря не растет: тексты удаленных слов освобождаются, TermId переиспользуются
+    SearchServer churn_server(""s);
+    size_t memory_usage = 0;
+    for (int round = 0; round < 2000; ++round) {
+        string document;
+        for (int i = 0; i < 10; ++i) {
+            document += "vocabulary_word_"s + to_string(round) + "_"s + to_string(i) + " "s;
+        }
+        churn_server.AddDocument(round, document, DocumentStatus::ACTUAL, {1});
+        churn_server.RemoveDocument(round);
+        if (round == 10) {
+            memory_usage = churn_server.GetTermsMemoryUsage();
+        }
+    }
+    ASSERT_EQUAL(churn_server.GetTermsMemoryUsage(), memory_usage);
+}
+
+void TestFindTopDocumentsCount() {
+    SearchServer search_server("and with"s);
+    // у документов с cat одинаковая релевантность, поэтому порядок задает рейтинг, равный id
+    for (int id = 0; id < 20; ++id) {
+        search_server.AddDocument(id, id % 2 ? "fluffy cat"s : "fluffy dog"s, DocumentStatus::ACTUAL, {id});
+    }
+
+    const auto top_documents = search_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 7);
+    ASSERT_EQUAL(top_documents.size(), 7);
+    for (size_t i = 0; i < top_documents.size(); ++i) {
+        ASSERT_EQUAL(top_documents[i].id, 19 - 2 * static_cast<int>(i));
+    }
+
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).size(), MAX_RESULT_DOCUMENT_COUNT);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 100).size(), 10);
+    ASSERT(search_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 0).empty());
+
+    // Память под выдачу не резервируется по top_k, поэтому огромный top_k допустим
+    for (const size_t huge_top_k: {size_t(500'000'000), size_t(1) << 62, numeric_limits<size_t>::max()}) {
+        const auto status = DocumentStatus::ACTUAL;
+        ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, status, huge_top_k).size(), 10);
+        ASSERT_EQUAL(search_server.FindTopDocuments(execution::par, "cat"s, status, huge_top_k).size(), 10);
+        ASSERT_EQUAL(search_server.FindTopDocuments(query_evaluation::max_score, "cat"s, status, huge_top_k).size(),
+                     10);
+    }
+
+    const auto even_documents = search_server.FindTopDocuments(
+            execution::par, "cat dog"s,
+            [](int document_id, DocumentStatus status, int rating) {
+                return document_id < 6;
+            }, 3);
+    ASSERT_EQUAL(even_documents.size(), 3);
+    ASSERT_EQUAL(even_documents[0].id, 5);
+    ASSERT_EQUAL(even_documents[1].id, 4);
+    ASSERT_EQUAL(even_documents[2].id, 3);
+}
+
+void TestScoreAccumulator() {
+    auto collect = [](const ScoreAccumulator &accumulator) {
+        map<DocumentSlot, double> scores;
+        accumulator.ForEach([&scores](DocumentSlot slot, double score) {
+            scores[slot] = score;
+        });
+        return scores;
+    };
+
+    ScoreAccumulator accumulator;
+    accumulator.Reset(10);
+    accumulator.Add(3, 0.5);
+    accumulator.Add(7, 1.0);
+    accumulator.Add(3, 0.25);
+    accumulator.Erase(7);
+    ASSERT_EQUAL(collect(accumulator), (map<DocumentSlot, double>{{3, 0.75}}));
+
+    // после Reset старые значения не видны, хотя массив не очищался
+    accumulator.Reset(20);
+    accumulator.Add(15, 2.0);
+    ScoreAccumulator other;
+    other.Reset(20);
+    other.Add(15, 1.0);
+    other.Add(3, 1.0);
+    accumulator.Merge(other);
+    ASSERT_EQUAL(collect(accumulator), (map<DocumentSlot, double>{{3, 1.0}, {15, 3.0}}));
+
+    // слоты удаленных документов переиспользуются новыми документами
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server.RemoveDocument(1);
+    search_server.AddDocument(3, "big cat nasty hair"s, DocumentStatus::ACTUAL, {1, 2, 8});
+    const auto found_docs = search_server.FindTopDocuments("nasty rat"s);
+    ASSERT_EQUAL(found_docs.size(), 1);
+    ASSERT_EQUAL(found_docs[0].id, 3);
+    ASSERT_EQUAL(search_server.FindTopDocuments(execution::par, "nasty curly"s).size(), 2);
+}
+
+void TestConcurrentMap() {
+    mt19937 generator;
+    const auto words = GenerateDictionary(generator, 1000, 5);
+    const auto texts = GenerateQueries(generator, words, 2000, 10);
+
+    map<string, int> expected;
+    for (const auto &text: texts) {
+        for (const auto word: SplitIntoWords(text)) {
+            ++expected[string(word)];
+        }
+    }
+
+    // ключи - строки, поэтому нужен хеш из стандартной библиотеки
+    ConcurrentMap<string, int> word_counts(37);
+    TaskScheduler task_scheduler({4});
+    task_scheduler.ParallelFor(texts.size(), [&word_counts, &texts](size_t text_index) {
+        const auto text_words = SplitIntoWords(texts[text_index]);
+        const size_t half = text_words.size() / 2;
+        for (size_t i = 0; i < half; ++i) {
+            word_counts.FetchAdd(string(text_words[i]), 1);
+        }
+        ConcurrentMap<string, int>::LocalShard shard(word_counts);
+        for (size_t i = half; i < text_words.size(); ++i) {
+            shard.FetchAdd(string(text_words[i]), 1);
+        }
+    });
+    ASSERT_EQUAL(word_counts.BuildOrdinaryMap(), expected);
+
+    word_counts.erase(expected.begin()->first);
+    expected.erase(expected.begin());
+    ASSERT_EQUAL(word_counts.FetchAdd(expected.begin()->first, 0), expected.begin()->second);
+    ASSERT_EQUAL(word_counts.BuildOrdinaryMap(), expected);
+}
+
+void TestMaxScoreEvaluation() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 3000, 20);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 3), {static_cast<int>(i % 7)});
+    }
+
+    for (int i = 0; i < 200; ++i) {
+        const string query = GenerateQuery(generator, dictionary, 5, 0.2);
+        AssertSameDocuments(search_server.FindTopDocuments(query),
+                            search_server.FindTopDocuments(query_evaluation::max_score, query), EPSILON, query);
+        AssertSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::BANNED, 20),
+                            search_server.FindTopDocuments(query_evaluation::max_score, query,
+                                                           DocumentStatus::BANNED, 20), EPSILON, query);
+        auto predicate = [](int document_id, DocumentStatus status, int rating) {
+            return document_id % 5 != 0 && rating > 2;
+        };
+        AssertSameDocuments(search_server.FindTopDocuments(query, predicate),
+                            search_server.FindTopDocuments(query_evaluation::max_score, query, predicate), EPSILON,
+                            query);
+    }
+}
+
+void TestCompressedPostings() {
+    {
+        const vector<uint32_t> values = {0, 1, 255, 256, 65535, 65536, 16777215, 16777216, UINT32_MAX, 7, 300};
+        vector<uint8_t> bytes;
+        EncodeStreamVByte(values.data(), values.size(), bytes);
+        const size_t encoded_size = bytes.size();
+        bytes.resize(encoded_size + STREAM_VBYTE_PADDING);
+        vector<uint32_t> decoded(values.size());
+        ASSERT(DecodeStreamVByte(bytes.data(), values.size(), decoded.data()) == bytes.data() + encoded_size);
+        ASSERT_EQUAL(decoded, values);
+
+        // Декодер с перестановкой SSSE3 и декодер по одному числу дают одно и то же на блоках любой длины
+        mt19937 generator;
+        for (size_t count = 0; count <= 130; ++count) {
+            vector<uint32_t> block(count);
+            for (uint32_t &value: block) {
+                value = generator() >> (8 * uniform_int_distribution(0, 3)(generator));
+            }
+            bytes.clear();
+            EncodeStreamVByte(block.data(), block.size(), bytes);
+            const size_t block_size = bytes.size();
+            bytes.resize(block_size + STREAM_VBYTE_PADDING);
+            vector<uint32_t> simd(count);
+            vector<uint32_t> scalar(count);
+            ASSERT(DecodeStreamVByte(bytes.data(), count, simd.data()) == bytes.data() + block_size);
+            ASSERT(DecodeStreamVByteScalar(bytes.data(), count, scalar.data()) == bytes.data() + block_size);
+            ASSERT_EQUAL(simd, block);
+            ASSERT_EQUAL(scalar, block);
+        }
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        ASSERT(IsStreamVByteSimdSupported() == static_cast<bool>(__builtin_cpu_supports("ssse3")));
+#endif
+
+        vector<uint32_t> deltas = {3, 1, 1, 5, 2, 0, 4};
+        PrefixSumDeltas(deltas.data(), deltas.size(), 10);
+        ASSERT_EQUAL(deltas, (vector<uint32_t>{13, 14, 15, 20, 22, 22, 26}));
+    }
+    {
+        // удаление из несжатой и сжатой частей: обход, переход к id и проверка наличия видят только живые вхождения
+        mt19937 generator;
+        for (const bool compressed: {false, true}) {
+            PostingList postings;
+            map<int, double> expected;
+            for (int id = 0; id < 1000; ++id) {
+                postings.Insert(id * 3, static_cast<DocumentSlot>(id), 1.0 / (id % 7 + 1));
+                expected[id * 3] = 1.0 / (id % 7 + 1);
+            }
+            if (compressed) {
+                postings.Compress([](int document_id) { return document_id / 3 % 7 + 1; });
+            }
+            const auto usage = postings.GetMemoryUsage();
+
+            auto check = [&]() {
+                ASSERT_EQUAL(postings.size(), expected.size());
+                vector<pair<int, double>> found;
+                for (PostingList::Cursor cursor(postings); !cursor.IsEnd(); cursor.Next()) {
+                    found.emplace_back(cursor->document_id, cursor->term_freq);
+                }
+                const vector<pair<int, double>> expected_found(expected.begin(), expected.end());
+                ASSERT(found == expected_found);
+                size_t block_total = 0;
+                for (PostingList::Cursor cursor(postings); !cursor.IsEnd(); cursor.NextBlock()) {
+                    block_total += cursor.BlockEnd() - cursor.BlockBegin();
+                }
+                ASSERT_EQUAL(block_total, expected.size());
+                PostingList::Cursor cursor(postings);
+                for (int id = 0; id < 3000; id += 97) {
+                    cursor.Seek(id);
+                    const auto it = expected.lower_bound(id);
+                    ASSERT_EQUAL(cursor.IsEnd(), it == expected.end());
+                    if (it != expected.end()) {
+                        ASSERT_EQUAL(cursor->document_id, it->first);
+                    }
+                    ASSERT_EQUAL(postings.Contains(id), expected.count(id) > 0);
+                }
+            };
+
+            // меньше четверти, поэтому в несжатой части удаленные только помечены
+            for (int i = 0; i < 200; ++i) {
+                const int id = static_cast<int>(generator() % 1000) * 3;
+                ASSERT_EQUAL(postings.Erase(id), expected.erase(id) > 0);
+            }
+            check();
+            ASSERT(!postings.Erase(1));
+            if (compressed) {
+                // список не распаковывается, блоки перекодируются на своих местах
+                ASSERT_EQUAL(postings.GetMemoryUsage().plain_bytes, 0);
+                ASSERT(postings.GetMemoryUsage().compressed_bytes <= usage.compressed_bytes);
+            } else {
+                // удаленный документ добавляется снова
+                int id = 0;
+                while (expected.count(id) > 0) {
+                    id += 3;
+                }
+                postings.Insert(id, 500, 0.5);
+                expected[id] = 0.5;
+                check();
+            }
+
+            vector<int> batch;
+            for (int id = 0; id < 3000; id += 2) {
+                batch.push_back(id);
+            }
+            size_t erased_count = 0;
+            for (const int id: batch) {
+                erased_count += expected.erase(id);
+            }
+            ASSERT_EQUAL(postings.Erase(batch), erased_count);
+            check();
+            if (compressed) {
+                // освободилось больше половины байт блоков, и они собраны
+                ASSERT_EQUAL(postings.GetMemoryUsage().plain_bytes, 0);
+                ASSERT(postings.GetMemoryUsage().compressed_bytes < usage.compressed_bytes);
+            }
+            ASSERT_EQUAL(postings.Erase(vector<int>(1, 3001)), 0);
+
+            // слияние с несжатой частью, где есть помеченные удаленными
+            vector<Posting> added;
+            for (int id = 2902; id < 3100; id += 6) {
+                added.push_back({id, static_cast<DocumentSlot>(id), 0.25});
+                expected[id] = 0.25;
+            }
+            postings.Insert(added.data(), added.data() + added.size());
+            check();
+        }
+    }
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 500, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 3000, 30);
+    const auto queries = GenerateQueries(generator, dictionary, 100, 6);
+
+    SearchServer plain_server(dictionary[0]);
+    SearchServer compressed_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        // четные id добавляются в обратном порядке, чтобы вставки шли и в середину списков
+        const int id = i % 2 ? static_cast<int>(i) : static_cast<int>(documents.size() - i);
+        plain_server.AddDocument(id, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        compressed_server.AddDocument(id, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    compressed_server.CompressPostings();
+
+    const auto usage = compressed_server.GetPostingsMemoryUsage();
+    ASSERT_EQUAL(usage.posting_count, plain_server.GetPostingsMemoryUsage().posting_count);
+    ASSERT_EQUAL(usage.plain_bytes, 0);
+    ASSERT(usage.compressed_bytes < usage.uncompressed_bytes / 2);
+
+    auto check_same = [&]() {
+        for (const auto &query: queries) {
+            for (const auto &[plain, compressed]: {
+                    pair{plain_server.FindTopDocuments(query), compressed_server.FindTopDocuments(query)},
+                    pair{plain_server.FindTopDocuments(execution::par, query),
+                         compressed_server.FindTopDocuments(execution::par, query)},
+                    pair{plain_server.FindTopDocuments(query_evaluation::max_score, query),
+                         compressed_server.FindTopDocuments(query_evaluation::max_score, query)}}) {
+                AssertSameDocuments(plain, compressed, 0);
+            }
+            for (const int id: {1, 2, 2500, 2999}) {
+                ASSERT(plain_server.MatchDocument(query, id) == compressed_server.MatchDocument(query, id));
+            }
+        }
+    };
+    check_same();
+
+    // изменения после сжатия: удаление из сжатой части не распаковывает списки, дописывание идет в хвост
+    for (const int id: {5, 700, 2998}) {
+        plain_server.RemoveDocument(id);
+        compressed_server.RemoveDocument(execution::par, id);
+    }
+    vector<int> removed_ids;
+    for (int id = 1000; id < 2000; ++id) {
+        removed_ids.push_back(id);
+    }
+    plain_server.RemoveDocuments(removed_ids);
+    compressed_server.RemoveDocuments(removed_ids);
+    ASSERT_EQUAL(compressed_server.GetPostingsMemoryUsage().plain_bytes, 0);
+    ASSERT(compressed_server.GetPostingsMemoryUsage().compressed_bytes <= usage.compressed_bytes);
+    check_same();
+    for (const int id: {3001, 3002}) {
+        plain_server.AddDocument(id, documents[id - 3001], DocumentStatus::ACTUAL, {1});
+        compressed_server.AddDocument(id, documents[id - 3001], DocumentStatus::ACTUAL, {1});
+    }
+    check_same();
+    compressed_server.CompressPostings();
+    check_same();
 }
 
 // Функция TestSearchServer является точкой входа для запуска тестов
+void TestIndexSnapshot() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 1000, 20);
+    const auto queries = GenerateQueries(generator, dictionary, 100, 6);
+
+    SearchServer search_server(dictionary[0] + " "s + dictionary[1]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i) * 3, documents[i],
+                                  i % 4 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED,
+                                  {static_cast<int>(i % 7), 2});
+    }
+    search_server.RemoveDocument(30);
+    search_server.CompressPostings();
+    search_server.AddDocument(5000, documents[0], DocumentStatus::ACTUAL, {5});
+
+    const string path = "test_index_snapshot.bin"s;
+    search_server.SaveSnapshot(path);
+    {
+        const IndexSnapshot snapshot(path);
+        ASSERT_EQUAL(snapshot.GetDocumentCount(), search_server.GetDocumentCount());
+        const auto has_even_rating = [](int document_id, DocumentStatus status, int rating) {
+            return rating % 2 == 0;
+        };
+        for (const auto &query: queries) {
+            for (const auto &[expected, actual]: {
+                    pair{search_server.FindTopDocuments(query), snapshot.FindTopDocuments(query)},
+                    pair{search_server.FindTopDocuments(query, DocumentStatus::BANNED, 20),
+                         snapshot.FindTopDocuments(query, DocumentStatus::BANNED, 20)},
+                    pair{search_server.FindTopDocuments(query, has_even_rating),
+                         snapshot.FindTopDocuments(query, has_even_rating)}}) {
+                AssertSameDocuments(expected, actual);
+            }
+            for (const int id: {0, 3, 12, 5000}) {
+                ASSERT(search_server.MatchDocument(query, id) == snapshot.MatchDocument(query, id));
+            }
+        }
+        ASSERT_EQUAL(snapshot.GetDocumentText(3), documents[1]);
+        ASSERT_EQUAL(snapshot.GetWordFrequencies(12), search_server.GetWordFrequencies(12));
+
+        try {
+            [[maybe_unused]] const auto result = snapshot.MatchDocument(queries[0], 30);
+            ASSERT_HINT(false, "Removed document must not be in snapshot");
+        } catch (const out_of_range &) {
+        }
+        try {
+            [[maybe_unused]] const auto result = snapshot.FindTopDocuments("--word"s);
+            ASSERT_HINT(false, "Query validation must match SearchServer");
+        } catch (const invalid_argument &) {
+        }
+    }
+
+    // снимок с номером или смещением за пределами секции не открывается
+    string bytes;
+    {
+        ifstream input(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    }
+    snapshot_format::Header header{};
+    memcpy(&header, bytes.data(), sizeof(header));
+    const string corrupted_path = "test_index_snapshot_corrupted.bin"s;
+    auto write_corrupted = [&](uint64_t offset, auto value) {
+        string corrupted = bytes;
+        memcpy(corrupted.data() + offset, &value, sizeof(value));
+        ofstream(corrupted_path, ios::binary).write(corrupted.data(), static_cast<streamsize>(corrupted.size()));
+    };
+    auto expect_corrupted = [&](uint64_t offset, auto value, const string &hint) {
+        write_corrupted(offset, value);
+        try {
+            const IndexSnapshot snapshot(corrupted_path);
+            ASSERT_HINT(false, hint);
+        } catch (const runtime_error &) {
+        }
+    };
+    // такие снимки открываются, но не загружаются в сервер
+    auto expect_inconsistent = [&](uint64_t offset, auto value, const string &hint) {
+        write_corrupted(offset, value);
+        try {
+            [[maybe_unused]] const auto loaded_server = SearchServer::LoadSnapshot(corrupted_path);
+            ASSERT_HINT(false, hint);
+        } catch (const invalid_argument &) {
+        }
+    };
+    expect_corrupted(header.stop_words_offset + offsetof(snapshot_format::StringRef, offset),
+                     static_cast<uint64_t>(bytes.size()),
+                     "Stop word outside of strings section must be rejected"s);
+    expect_corrupted(header.terms_offset + offsetof(snapshot_format::Term, posting_count), header.posting_count + 1,
+                     "Term postings outside of postings section must be rejected"s);
+    expect_corrupted(header.postings_offset + offsetof(Posting, slot),
+                     static_cast<DocumentSlot>(header.document_count),
+                     "Posting slot outside of documents section must be rejected"s);
+    expect_corrupted(header.documents_offset + offsetof(snapshot_format::DocumentRecord, terms_begin),
+                     header.document_term_count, "Document terms outside of their section must be rejected"s);
+    expect_corrupted(header.documents_offset + offsetof(snapshot_format::DocumentRecord, text) +
+                     offsetof(snapshot_format::StringRef, size), numeric_limits<uint64_t>::max(),
+                     "Document text outside of strings section must be rejected"s);
+    expect_corrupted(header.document_terms_offset + offsetof(snapshot_format::DocumentTerm, term),
+                     static_cast<uint64_t>(header.term_count),
+                     "Unknown term in document must be rejected"s);
+    int32_t first_document_id = 0;
+    memcpy(&first_document_id, bytes.data() + header.documents_offset, sizeof(first_document_id));
+    expect_inconsistent(header.documents_offset + sizeof(snapshot_format::DocumentRecord) +
+                        offsetof(snapshot_format::DocumentRecord, id), first_document_id,
+                        "Duplicate document id must be rejected"s);
+    expect_inconsistent(header.postings_offset + offsetof(Posting, document_id), -1,
+                        "Posting of another document must be rejected"s);
+    expect_inconsistent(header.terms_offset + sizeof(snapshot_format::Term) + offsetof(snapshot_format::Term, word),
+                        snapshot_format::StringRef{}, "Unsorted terms must be rejected"s);
+    {
+        const auto loaded_server = SearchServer::LoadSnapshot(path);
+        ASSERT_EQUAL(loaded_server.GetDocumentCount(), search_server.GetDocumentCount());
+    }
+    filesystem::remove(corrupted_path);
+
+    // обрезанный файл не открывается
+    filesystem::resize_file(path, filesystem::file_size(path) - 1);
+    try {
+        const IndexSnapshot snapshot(path);
+        ASSERT_HINT(false, "Truncated snapshot must be rejected");
+    } catch (const runtime_error &) {
+    }
+    filesystem::remove(path);
+}
+
+void TestDurableSearchServer() {
+    ASSERT_EQUAL(ComputeCrc32("123456789"s), 0xCBF43926U);
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 200, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 300, 15);
+    const auto queries = GenerateQueries(generator, dictionary, 50, 5);
+    const string stop_words = dictionary[0] + " "s + dictionary[1];
+
+    const auto directory = (filesystem::temp_directory_path() / "search_server_durable_test"s).string();
+    filesystem::remove_all(directory);
+
+    // эталон, к которому применяются те же изменения
+    SearchServer expected_server(stop_words);
+    auto check_same = [&](const SearchServer &search_server) {
+        ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const auto &query: queries) {
+            AssertSameDocuments(expected_server.FindTopDocuments(query), search_server.FindTopDocuments(query));
+        }
+    };
+    auto add_documents = [&](DurableSearchServer &search_server, size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const auto status = i % 5 ? DocumentStatus::ACTUAL : DocumentStatus::IRRELEVANT;
+            const vector<int> ratings = {static_cast<int>(i % 10), -1};
+            search_server.AddDocument(static_cast<int>(i), documents[i], status, ratings);
+            expected_server.AddDocument(static_cast<int>(i), documents[i], status, ratings);
+        }
+    };
+
+    {
+        DurableSearchServer search_server(directory, stop_words, {4});
+        add_documents(search_server, 0, 100);
+        search_server.RemoveDocument(7);
+        expected_server.RemoveDocument(7);
+        ASSERT(!search_server.GetSearchServer().HasDocument(7) && search_server.GetSearchServer().HasDocument(8));
+        // удаление отсутствующего документа ничего не меняет
+        search_server.RemoveDocument(7);
+        // некорректный документ отклоняется и не попадает в журнал
+        try {
+            search_server.AddDocument(0, "duplicate"s, DocumentStatus::ACTUAL, {});
+            ASSERT_HINT(false, "Duplicate document must be rejected");
+        } catch (const invalid_argument &) {
+        }
+    }
+    {
+        // только журнал
+        DurableSearchServer search_server(directory, ""s);
+        check_same(search_server.GetSearchServer());
+        search_server.Compact();
+        add_documents(search_server, 100, 200);
+        search_server.RemoveDocument(150);
+        expected_server.RemoveDocument(150);
+        search_server.WaitForCompaction();
+        search_server.Compact();
+        add_documents(search_server, 200, 250);
+        search_server.WaitForCompaction();
+        check_same(search_server.GetSearchServer());
+    }
+    vector<string> file_names;
+    for (const auto &entry: filesystem::directory_iterator(directory)) {
+        file_names.push_back(entry.path().filename().string());
+    }
+    sort(file_names.begin(), file_names.end());
+    ASSERT_EQUAL(file_names, (vector<string>{"snapshot.3.bin"s, "wal.3.log"s}));
+
+    // оборванная при сбое запись в конце журнала отбрасывается
+    const auto log_path = (filesystem::path(directory) / "wal.3.log"s).string();
+    const auto log_size = filesystem::file_size(log_path);
+    {
+        ofstream out(log_path, ios::binary | ios::app);
+        out << "\x20\x00\x00\x00torn"s;
+    }
+    {
+        // снимок и журнал
+        DurableSearchServer search_server(directory, ""s);
+        check_same(search_server.GetSearchServer());
+        ASSERT_EQUAL(filesystem::file_size(log_path), log_size);
+        add_documents(search_server, 250, 300);
+    }
+    {
+        DurableSearchServer search_server(directory, ""s, {0});
+        check_same(search_server.GetSearchServer());
+    }
+
+    // ошибка сброса на диск не проходит молча
+    SyncPath(log_path);
+    SyncDirectory(directory);
+    try {
+        SyncPath((filesystem::path(directory) / "missing.bin"s).string());
+        ASSERT_HINT(false, "Missing file can't be synced");
+    } catch (const runtime_error &) {
+    }
+    filesystem::remove_all(directory);
+}
+
+void TestRemoveDocuments() {
+    {
+        // освобожденный TermId выдается снова, остальные слова находятся после сдвига ячеек
+        TermDictionary terms;
+        vector<string> words;
+        for (int i = 0; i < 1000; ++i) {
+            words.push_back("word"s + to_string(i));
+            ASSERT_EQUAL(terms.Intern(words.back()), static_cast<TermId>(i));
+        }
+        for (int i = 0; i < 1000; i += 3) {
+            terms.Erase(terms.Find(words[i]));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_EQUAL(terms.Find(words[i]), i % 3 ? static_cast<TermId>(i) : INVALID_TERM_ID);
+        }
+        const TermId reused = terms.Intern("new word"s);
+        ASSERT(reused < 1000 && reused % 3 == 0);
+        ASSERT_EQUAL(terms.size(), 1000);
+        ASSERT_EQUAL(terms.Find("new word"s), reused);
+    }
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 400, 12);
+    const auto queries = GenerateQueries(generator, dictionary, 50, 4);
+    vector<int> removed_ids;
+    for (int id = 0; id < 400; id += 2) {
+        removed_ids.push_back(id);
+    }
+    // повторы и отсутствующие id пропускаются
+    removed_ids.push_back(0);
+    removed_ids.push_back(1000);
+
+    auto make_server = [&](bool skip_removed) {
+        SearchServer search_server(dictionary[0]);
+        for (int id = 0; id < 400; ++id) {
+            if (!skip_removed || id % 2) {
+                search_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {id % 7});
+            }
+        }
+        search_server.CompressPostings();
+        return search_server;
+    };
+    const SearchServer expected_server = make_server(true);
+    auto check_same = [&](const SearchServer &search_server) {
+        ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const auto &query: queries) {
+            AssertSameDocuments(expected_server.FindTopDocuments(query), search_server.FindTopDocuments(query));
+        }
+        for (int id = 1; id < 400; id += 2) {
+            ASSERT_EQUAL(search_server.GetWordFrequencies(id), expected_server.GetWordFrequencies(id));
+        }
+    };
+
+    SearchServer sequential = make_server(false);
+    SearchServer parallel = make_server(false);
+    for (const int id: removed_ids) {
+        sequential.RemoveDocument(execution::seq, id);
+        parallel.RemoveDocument(execution::par, id);
+    }
+    check_same(sequential);
+    check_same(parallel);
+
+    SearchServer batch_sequential = make_server(false);
+    SearchServer batch_parallel = make_server(false);
+    batch_sequential.RemoveDocuments(removed_ids);
+    batch_parallel.RemoveDocuments(execution::par, removed_ids);
+    check_same(batch_sequential);
+    check_same(batch_parallel);
+
+    // слова удаленных документов освобождаются и переиспользуются новыми документами
+    for (int id = 1; id < 400; id += 2) {
+        batch_sequential.RemoveDocument(id);
+    }
+    batch_sequential.AddDocument(1, "brand new words"s, DocumentStatus::ACTUAL, {1});
+    const auto [words, status] = batch_sequential.MatchDocument("new -missing"s, 1);
+    ASSERT_EQUAL(words, (vector<string_view>{"new"sv}));
+    ASSERT_EQUAL(batch_sequential.FindTopDocuments(dictionary[1]).size(), 0);
+}
+
+void TestTextArena() {
+    mt19937 generator;
+    TextArena arena;
+    map<TextId, string> expected;
+    auto check_texts = [&]() {
+        for (const auto &[text_id, text]: expected) {
+            ASSERT_EQUAL(arena.Get(text_id), text);
+        }
+    };
+
+    // тексты разной длины, в том числе пустые и длиннее блока
+    for (int i = 0; i < 5000; ++i) {
+        string text = i % 1000 == 0 ? string(TEXT_ARENA_CHUNK_SIZE + i, 'x') : GenerateWord(generator, 300);
+        if (i % 700 == 0) {
+            text.clear();
+        }
+        const TextId text_id = arena.Store(text);
+        ASSERT_EQUAL(expected.count(text_id), 0);
+        expected.emplace(text_id, move(text));
+    }
+    check_texts();
+
+    // удаляется 80% текстов, память должна уменьшиться вслед за живыми байтами
+    vector<TextId> released;
+    for (auto it = expected.begin(); it != expected.end();) {
+        if (uniform_int_distribution(0, 4)(generator) > 0) {
+            arena.Release(it->first);
+            released.push_back(it->first);
+            it = expected.erase(it);
+        } else {
+            ++it;
+        }
+        ASSERT(arena.GetUsedBytes() <= 2 * arena.GetLiveBytes() + TEXT_ARENA_CHUNK_SIZE);
+    }
+    check_texts();
+    ASSERT(arena.GetMemoryUsage() < 2 * arena.GetLiveBytes() + 4 * TEXT_ARENA_CHUNK_SIZE);
+
+    // TextId удаленных текстов выдаются снова
+    const TextId reused = arena.Store("reused"s);
+    ASSERT(find(released.begin(), released.end(), reused) != released.end());
+    expected.emplace(reused, "reused"s);
+
+    // копия не зависит от оригинала
+    TextArena copy = arena;
+    for (const auto &[text_id, text]: expected) {
+        arena.Release(text_id);
+    }
+    ASSERT_EQUAL(arena.GetLiveBytes(), 0);
+    ASSERT_EQUAL(arena.GetUsedBytes(), 0);
+    for (const auto &[text_id, text]: expected) {
+        ASSERT_EQUAL(copy.Get(text_id), text);
+    }
+
+    // тексты удаленных документов сервера освобождаются
+    SearchServer search_server;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 2000, 50);
+    for (int id = 0; id < 2000; ++id) {
+        search_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {1});
+    }
+    const size_t server_usage = search_server.GetDocumentTextsMemoryUsage();
+    for (int id = 0; id < 2000; ++id) {
+        if (id % 10) {
+            search_server.RemoveDocument(id);
+        }
+    }
+    ASSERT(search_server.GetDocumentTextsMemoryUsage() < server_usage / 3);
+}
+
+void TestAddDocuments() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 500, 8);
+    const auto texts = GenerateQueries(generator, dictionary, 600, 20);
+    const auto queries = GenerateQueries(generator, dictionary, 50, 4);
+    const string stop_words = dictionary[0] + " "s + dictionary[1];
+
+    // часть документов уже есть в сжатом индексе, новые id идут вперемешку со старыми
+    auto make_server = [&]() {
+        SearchServer search_server(stop_words);
+        for (int id = 0; id < 600; id += 3) {
+            search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+        }
+        search_server.CompressPostings();
+        return search_server;
+    };
+    vector<DocumentToAdd> batch;
+    for (int id = 599; id >= 0; --id) {
+        if (id % 3) {
+            batch.push_back({id, texts[id], id % 4 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, {id % 5, 1}});
+        }
+    }
+    batch.push_back({1000, ""sv, DocumentStatus::ACTUAL, {}});
+
+    SearchServer expected_server = make_server();
+    for (const auto &document: batch) {
+        expected_server.AddDocument(document.document_id, document.document, document.status, document.ratings);
+    }
+    SearchServer sequential = make_server();
+    sequential.AddDocuments(batch);
+    SearchServer parallel = make_server();
+    parallel.AddDocuments(execution::par, batch);
+
+    for (const SearchServer *search_server: {&sequential, &parallel}) {
+        ASSERT_EQUAL(search_server->GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const auto &query: queries) {
+            for (const auto status: {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                AssertSameDocuments(expected_server.FindTopDocuments(query, status),
+                                    search_server->FindTopDocuments(query, status), 0);
+            }
+        }
+        for (const auto &document: batch) {
+            ASSERT_EQUAL(search_server->GetWordFrequencies(document.document_id),
+                         expected_server.GetWordFrequencies(document.document_id));
+        }
+    }
+
+    // ошибка первого некорректного документа, сервер не меняется
+    auto check_error = [&](const vector<DocumentToAdd> &documents, const string &message) {
+        for (const bool is_parallel: {false, true}) {
+            SearchServer search_server = make_server();
+            try {
+                if (is_parallel) {
+                    search_server.AddDocuments(execution::par, documents);
+                } else {
+                    search_server.AddDocuments(documents);
+                }
+                ASSERT_HINT(false, "Invalid batch must be rejected");
+            } catch (const invalid_argument &e) {
+                ASSERT_EQUAL(string(e.what()), message);
+            }
+            ASSERT_EQUAL(search_server.GetDocumentCount(), 200);
+        }
+    };
+    string invalid_word_message;
+    try {
+        SearchServer search_server;
+        search_server.AddDocument(1, "bad wo\x12rd"s, DocumentStatus::ACTUAL, {});
+    } catch (const invalid_argument &e) {
+        invalid_word_message = e.what();
+    }
+    ASSERT(!invalid_word_message.empty());
+    check_error({{1, texts[1], DocumentStatus::ACTUAL, {}}, {-1, "x"sv, DocumentStatus::ACTUAL, {}}},
+                "Document ID must be a natural number."s);
+    check_error({{1, texts[1], DocumentStatus::ACTUAL, {}}, {3, "x"sv, DocumentStatus::ACTUAL, {}}},
+                "Document with this ID already exists."s);
+    check_error({{1, texts[1], DocumentStatus::ACTUAL, {}}, {1, "x"sv, DocumentStatus::ACTUAL, {}}},
+                "Document with this ID already exists."s);
+    check_error({{1, "bad wo\x12rd"sv, DocumentStatus::ACTUAL, {}}, {-1, "x"sv, DocumentStatus::ACTUAL, {}}},
+                invalid_word_message);
+}
+
+void TestVersionedSearchServer() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto texts = GenerateQueries(generator, dictionary, 400, 10);
+    const auto queries = GenerateQueries(generator, dictionary, 30, 3);
+
+    VersionedSearchServer search_server(SearchServer("and in"s));
+    SearchServer expected_server("and in"s);
+    auto check_same = [&](const SearchServer &actual_server) {
+        ASSERT_EQUAL(actual_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const auto &query: queries) {
+            AssertSameDocuments(expected_server.FindTopDocuments(query), actual_server.FindTopDocuments(query), 0);
+        }
+    };
+
+    // изменения не видны до Publish, удерживаемая версия не меняется
+    const auto empty_version = search_server.GetVersion();
+    search_server.AddDocument(0, texts[0], DocumentStatus::ACTUAL, {1});
+    expected_server.AddDocument(0, texts[0], DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.GetVersion()->GetDocumentCount(), 0);
+    search_server.Publish();
+    ASSERT_EQUAL(empty_version->GetDocumentCount(), 0);
+    check_same(*search_server.GetVersion());
+
+    // пока читатель держит версию, следующая копируется, иначе готовится на месте предыдущей
+    for (int round = 1; round < 20; ++round) {
+        const auto held_version = round % 3 ? nullptr : search_server.GetVersion();
+        const int held_count = held_version ? held_version->GetDocumentCount() : 0;
+        for (int id = round * 20; id < round * 20 + 20; ++id) {
+            search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 3});
+            expected_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 3});
+        }
+        search_server.RemoveDocument(round * 7);
+        expected_server.RemoveDocument(round * 7);
+        try {
+            search_server.AddDocument(round * 20, "duplicate"s, DocumentStatus::ACTUAL, {});
+            ASSERT_HINT(false, "Duplicate document must be rejected");
+        } catch (const invalid_argument &) {
+        }
+        search_server.Publish();
+        check_same(*search_server.GetVersion());
+        if (held_version) {
+            ASSERT_EQUAL(held_version->GetDocumentCount(), held_count);
+        }
+    }
+
+    // поиск во время изменений: каждая версия целиком соответствует одному из вызовов Publish
+    VersionedSearchServer concurrent_server;
+    atomic_bool is_writing = true;
+    auto reader = async(launch::async, [&]() {
+        do {
+            const auto version = concurrent_server.GetVersion();
+            const int document_count = version->GetDocumentCount();
+            ASSERT_EQUAL(document_count % 10, 0);
+            ASSERT_EQUAL(version->FindTopDocuments("common"s).size(),
+                         static_cast<size_t>(min(document_count, MAX_RESULT_DOCUMENT_COUNT)));
+        } while (is_writing);
+    });
+    for (int id = 0; id < 400; ++id) {
+        concurrent_server.AddDocument(id, "common "s + texts[id], DocumentStatus::ACTUAL, {1});
+        if (id % 10 == 9) {
+            concurrent_server.Publish();
+        }
+    }
+    is_writing = false;
+    reader.get();
+    ASSERT_EQUAL(concurrent_server.GetVersion()->GetDocumentCount(), 400);
+}
+
+void TestSegmentedSearchServer() {
+    {
+        CorpusStatistics statistics;
+        statistics.AddDocument({{"cat"sv, 0.5}, {"dog"sv, 0.5}});
+        statistics.AddDocument({{"cat"sv, 1.0}});
+        ASSERT_EQUAL(statistics.GetDocumentCount(), 2);
+        ASSERT_EQUAL(statistics.GetDocumentFrequency("cat"sv), 2);
+        statistics.RemoveDocument({{"cat"sv, 0.5}, {"dog"sv, 0.5}});
+        ASSERT_EQUAL(statistics.GetDocumentFrequency("cat"sv), 1);
+        ASSERT_EQUAL(statistics.GetDocumentFrequency("dog"sv), 0);
+    }
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto texts = GenerateQueries(generator, dictionary, 1000, 10);
+    const auto queries = GenerateQueries(generator, dictionary, 50, 4);
+    const string stop_words = dictionary[0] + " "s + dictionary[1];
+
+    SegmentedSearchServer search_server(stop_words, {20, 3});
+    SearchServer expected_server(stop_words);
+    auto check_same = [&]() {
+        ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const auto &query: queries) {
+            for (const auto status: {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                AssertSameDocuments(expected_server.FindTopDocuments(query, status),
+                                    search_server.FindTopDocuments(query, status));
+            }
+        }
+        for (const int id: expected_server) {
+            ASSERT(search_server.MatchDocument(queries[0], id) == expected_server.MatchDocument(queries[0], id));
+        }
+    };
+
+    for (int id = 0; id < 1000; ++id) {
+        const auto status = id % 7 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+        search_server.AddDocument(id, texts[id], status, {id % 10});
+        expected_server.AddDocument(id, texts[id], status, {id % 10});
+        // удаление из изменяемого сегмента, из неизменяемых и во время слияния
+        if (id % 3 == 2) {
+            const int removed_id = (id * 37) % (id + 1);
+            search_server.RemoveDocument(removed_id);
+            expected_server.RemoveDocument(removed_id);
+        }
+        if (id % 250 == 0) {
+            check_same();
+        }
+    }
+    check_same();
+    search_server.WaitForMerges();
+    check_same();
+    ASSERT(search_server.GetSegmentCount() < 1000 / 20);
+
+    // удаленный id можно добавить снова, существующий - нельзя
+    int removed_id = 0;
+    while (find(expected_server.begin(), expected_server.end(), removed_id) != expected_server.end()) {
+        ++removed_id;
+    }
+    search_server.AddDocument(removed_id, "brand new"s, DocumentStatus::ACTUAL, {1});
+    expected_server.AddDocument(removed_id, "brand new"s, DocumentStatus::ACTUAL, {1});
+    check_same();
+    try {
+        search_server.AddDocument(removed_id, "duplicate"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Duplicate document must be rejected");
+    } catch (const invalid_argument &e) {
+        ASSERT_EQUAL(string(e.what()), "Document with this ID already exists."s);
+    }
+}
+
+void TestShardedSearchServer() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto texts = GenerateQueries(generator, dictionary, 300, 10);
+    const auto queries = GenerateQueries(generator, dictionary, 50, 4);
+    const string stop_words = dictionary[0] + " "s + dictionary[1];
+
+    ShardedSearchServer search_server(3, stop_words);
+    SearchServer expected_server(stop_words);
+    for (int id = 0; id < 300; ++id) {
+        const auto status = id % 7 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+        search_server.AddDocument(id, texts[id], status, {id % 10, 3});
+        expected_server.AddDocument(id, texts[id], status, {id % 10, 3});
+    }
+    for (int id = 0; id < 300; id += 4) {
+        search_server.RemoveDocument(id);
+        expected_server.RemoveDocument(id);
+    }
+    search_server.RemoveDocument(1000);
+
+    ASSERT_EQUAL(search_server.GetShardCount(), 3);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+    for (const auto &query: queries) {
+        for (const auto status: {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            AssertSameDocuments(expected_server.FindTopDocuments(query, status, 10),
+                                search_server.FindTopDocuments(query, status, 10));
+        }
+    }
+    for (const int id: expected_server) {
+        const auto [expected_words, expected_status] = expected_server.MatchDocument(queries[1], id);
+        auto [words, status] = search_server.MatchDocument(queries[1], id);
+        sort(words.begin(), words.end());
+        ASSERT_EQUAL(words, vector<string>(expected_words.begin(), expected_words.end()));
+        ASSERT(status == expected_status);
+    }
+
+    // ошибки шардов приходят с тем же типом и текстом, что у SearchServer
+    auto get_error = [](auto function) {
+        try {
+            function();
+        } catch (const invalid_argument &e) {
+            return "invalid_argument: "s + e.what();
+        } catch (const out_of_range &e) {
+            return "out_of_range: "s + e.what();
+        }
+        return ""s;
+    };
+    auto check_same_error = [&](auto function, auto expected_function) {
+        const string expected_error = get_error(expected_function);
+        ASSERT(!expected_error.empty());
+        ASSERT_EQUAL(get_error(function), expected_error);
+    };
+    for (const auto &[document_id, text]: vector<pair<int, string>>{{1, "text"s}, {-1, "text"s}, {301, "bad \x12"s}}) {
+        check_same_error([&]() { search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {}); },
+                         [&]() { expected_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {}); });
+    }
+    for (const string &query: {"--cat"s, "cat -"s}) {
+        check_same_error([&]() { [[maybe_unused]] const auto result = search_server.FindTopDocuments(query); },
+                         [&]() { [[maybe_unused]] const auto result = expected_server.FindTopDocuments(query); });
+    }
+    check_same_error([&]() { [[maybe_unused]] const auto result = search_server.MatchDocument("cat"s, 0); },
+                     [&]() { [[maybe_unused]] const auto result = expected_server.MatchDocument("cat"s, 0); });
+    ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+
+    // шарды запускаются, пока рабочие потоки планировщика выполняют задачи
+    TaskScheduler task_scheduler({4});
+    atomic<bool> stopping = false;
+    thread busy_thread([&task_scheduler, &stopping] {
+        while (!stopping) {
+            task_scheduler.ParallelFor(64, [](size_t i) {
+                vector<string> strings(i, string(100, 'x'));
+            });
+        }
+    });
+    ShardedSearchServer forked_server(2, stop_words);
+    for (const int id: expected_server) {
+        forked_server.AddDocument(id, texts[id], id % 7 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED,
+                                  {id % 10, 3});
+    }
+    for (const auto &query: queries) {
+        AssertSameDocuments(expected_server.FindTopDocuments(query), forked_server.FindTopDocuments(query));
+    }
+    stopping = true;
+    busy_thread.join();
+}
+
+void TestQueryCache() {
+    {
+        QueryCache cache(2);
+        ASSERT(!cache.Find("a"s, 0));
+        cache.Insert("a"s, 0, {Document(1, 0.5, 1)});
+        cache.Insert("b"s, 0, {});
+        ASSERT_EQUAL(cache.Find("a"s, 0)->size(), 1);
+        // "b" использован давнее всех и вытесняется
+        cache.Insert("c"s, 0, {});
+        ASSERT(!cache.Find("b"s, 0));
+        // запись старого поколения не возвращается
+        ASSERT(!cache.Find("a"s, 1));
+        const auto statistics = cache.GetStatistics();
+        ASSERT_EQUAL(statistics.hits, 1);
+        ASSERT_EQUAL(statistics.misses, 3);
+        ASSERT_EQUAL(statistics.evictions, 1);
+    }
+
+    SearchServer search_server("and with"s);
+    search_server.SetQueryCacheCapacity(10);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+
+    const auto first = search_server.FindTopDocuments("fluffy groomed cat"s);
+    // те же слова в другом порядке, с повтором и неизвестным словом - тот же разобранный запрос
+    const auto second = search_server.FindTopDocuments(execution::par, "cat cat groomed fluffy unknown"s);
+    AssertSameDocuments(first, second, 0);
+    ASSERT_EQUAL(search_server.GetQueryCacheStatistics().hits, 1);
+    ASSERT_EQUAL(search_server.GetQueryCacheStatistics().misses, 1);
+
+    // другой статус и другой ключ предиката - разные записи, предикат без ключа кеш не использует
+    ASSERT_EQUAL(search_server.FindTopDocuments("fluffy groomed cat"s, DocumentStatus::BANNED).size(), 1);
+    auto is_even = [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; };
+    ASSERT_EQUAL(search_server.FindTopDocumentsCached(execution::seq, "fluffy groomed cat"s, "even"sv, is_even).size(), 1);
+    ASSERT_EQUAL(search_server.FindTopDocumentsCached(execution::seq, "fluffy groomed cat"s, "even"sv, is_even).size(), 1);
+    ASSERT_EQUAL(search_server.FindTopDocuments("fluffy groomed cat"s, is_even).size(), 1);
+    ASSERT_EQUAL(search_server.GetQueryCacheStatistics().hits, 2);
+    ASSERT_EQUAL(search_server.GetQueryCacheStatistics().misses, 3);
+
+    // изменение индекса делает записи устаревшими
+    search_server.AddDocument(4, "fluffy cat"s, DocumentStatus::ACTUAL, {9});
+    ASSERT_EQUAL(search_server.FindTopDocuments("fluffy groomed cat"s).size(), 3);
+    search_server.RemoveDocument(4);
+    ASSERT_EQUAL(search_server.FindTopDocuments("fluffy groomed cat"s).size(), 2);
+    search_server.SetStopWords("cat"s);
+    ASSERT_EQUAL(search_server.FindTopDocuments("fluffy groomed cat"s).size(), 1);
+    ASSERT_EQUAL(search_server.GetQueryCacheStatistics().hits, 2);
+
+    // копия сервера начинает с пустого кеша
+    const SearchServer copy = search_server;
+    ASSERT_EQUAL(copy.FindTopDocuments("fluffy"s).size(), 1);
+    ASSERT_EQUAL(copy.GetQueryCacheStatistics().misses, 1);
+    ASSERT_EQUAL(copy.GetQueryCacheStatistics().hits, 0);
+}
+
+void TestImpactScores() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 1200, 20);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < 1000; ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 3), {static_cast<int>(i % 7)});
+    }
+
+    // Без индекса импактов релевантность считается точно
+    ASSERT_EQUAL(search_server.GetImpactScoreError(), 0.0);
+    ASSERT_EQUAL(search_server.FindTopDocuments(query_evaluation::impact_scores, documents[0]).size(),
+                 search_server.FindTopDocuments(documents[0]).size());
+
+    try {
+        search_server.EnableImpactScores({17, 0.1});
+        ASSERT_HINT(false, "Impact bits are out of range");
+    } catch (const invalid_argument &) {
+    }
+
+    // Выдачи совпадают с точностью до ошибки квантования каждого слова запроса
+    auto check_close = [&search_server](const string &query, size_t max_word_count) {
+        const double tolerance = max_word_count * search_server.GetImpactScoreError() + EPSILON;
+        auto predicate = [](int document_id, DocumentStatus status, int rating) {
+            return document_id % 5 != 0 && rating > 2;
+        };
+        for (const auto &[exact, approximate]: {
+                pair{search_server.FindTopDocuments(query, DocumentStatus::BANNED, 20),
+                     search_server.FindTopDocuments(query_evaluation::impact_scores, query, DocumentStatus::BANNED, 20)},
+                pair{search_server.FindTopDocuments(query, predicate),
+                     search_server.FindTopDocuments(query_evaluation::impact_scores, query, predicate)}}) {
+            ASSERT_EQUAL_HINT(approximate.size(), exact.size(), query);
+            for (size_t i = 0; i < exact.size(); ++i) {
+                ASSERT_HINT(abs(exact[i].relevance - approximate[i].relevance) <= tolerance, query);
+            }
+        }
+    };
+
+    for (const int impact_bits: {16, 8}) {
+        search_server.EnableImpactScores({impact_bits, 0.1});
+        ASSERT(search_server.GetImpactScoreError() > 0);
+        for (int i = 0; i < 100; ++i) {
+            check_close(GenerateQuery(generator, dictionary, 5, 0.2), 5);
+        }
+    }
+
+    // Импакты пересчитываются, когда документов стало больше чем на 10% (1101-й документ)
+    search_server.EnableImpactScores({16, 0.1});
+    for (size_t i = 1000; i < 1050; ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 3), {static_cast<int>(i % 7)});
+    }
+    // вхождения новых документов сливаются с индексом при первом запросе, в том числе параллельном
+    {
+        const auto queries = GenerateQueries(generator, dictionary, 64, 5);
+        vector<vector<Document>> found(queries.size());
+        TaskScheduler task_scheduler({4});
+        task_scheduler.ParallelFor(queries.size(), [&](size_t i) {
+            found[i] = search_server.FindTopDocuments(query_evaluation::impact_scores, queries[i]);
+        });
+        for (size_t i = 0; i < queries.size(); ++i) {
+            AssertSameDocuments(search_server.FindTopDocuments(query_evaluation::impact_scores, queries[i]), found[i],
+                                0, queries[i]);
+        }
+    }
+    for (size_t i = 1050; i < 1101; ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 3), {static_cast<int>(i % 7)});
+    }
+    for (int i = 0; i < 50; ++i) {
+        check_close(GenerateQuery(generator, dictionary, 5, 0.2), 5);
+    }
+
+    // Слово из всех документов дает нулевой вклад, но документы находятся
+    {
+        SearchServer single_server;
+        single_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+        single_server.EnableImpactScores();
+        ASSERT_EQUAL(single_server.FindTopDocuments(query_evaluation::impact_scores, "cat"s).size(), 1);
+    }
+
+    // Новые документы попадают в индекс сразу, удаленные - сразу пропадают
+    search_server.AddDocument(5000, "uniqueword"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.FindTopDocuments(query_evaluation::impact_scores, "uniqueword"s).size(), 1);
+    search_server.RemoveDocument(5000);
+    ASSERT(search_server.FindTopDocuments(query_evaluation::impact_scores, "uniqueword"s).empty());
+
+    // При пересчете на каждое изменение выдача всегда в пределах ошибки квантования
+    search_server.EnableImpactScores({16, 0});
+    search_server.RemoveDocuments({1, 2, 3, 500, 1050});
+    for (size_t i = 1101; i < documents.size(); i += 10) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 3), {static_cast<int>(i % 7)});
+    }
+    for (int i = 0; i < 50; ++i) {
+        check_close(GenerateQuery(generator, dictionary, 5, 0.2), 5);
+    }
+}
+
+void TestWordTokenizer() {
+    // Разбор по одному символу, с которым сравнивается блочный
+    auto split_naive = [](string_view text) {
+        vector<pair<string_view, bool>> words;
+        size_t begin = 0;
+        while (begin < text.size()) {
+            if (text[begin] == ' ') {
+                ++begin;
+                continue;
+            }
+            size_t end = begin;
+            bool is_valid_word = true;
+            for (; end < text.size() && text[end] != ' '; ++end) {
+                is_valid_word = is_valid_word && !(text[end] >= '\0' && text[end] < ' ');
+            }
+            words.emplace_back(text.substr(begin, end - begin), is_valid_word);
+            begin = end;
+        }
+        return words;
+    };
+    auto split = [](string_view text) {
+        vector<pair<string_view, bool>> words;
+        ForEachWord(text, [&words](string_view word, bool is_valid_word) {
+            words.emplace_back(word, is_valid_word);
+        });
+        return words;
+    };
+
+    ASSERT(split(""sv).empty());
+    ASSERT(split("    "sv).empty());
+    ASSERT_EQUAL(SplitIntoWords("  white  cat "sv), (vector<string_view>{"white"sv, "cat"sv}));
+    ASSERT_EQUAL(split("cat\tdog"sv), (vector<pair<string_view, bool>>{{"cat\tdog"sv, false}}));
+    ASSERT(IsValidWord("\xD0\xBA\xD0\xBE\xD1\x82"sv));
+    ASSERT(!IsValidWord(string(100, 'a') + '\x1F'));
+
+    // Слова любой длины, в том числе через границы блоков, с управляющими и не-ASCII байтами
+    mt19937 generator;
+    const string alphabet = "ab -\x01\x1F\x7F\x80\xFF"s;
+    vector<string_view> words;
+    for (int i = 0; i < 2000; ++i) {
+        const size_t size = uniform_int_distribution<size_t>(0, 300)(generator);
+        // Длинные куски без пробелов чередуются с частыми пробелами
+        const int space_weight = uniform_int_distribution<int>(0, 1)(generator) ? 1 : 40;
+        discrete_distribution<int> symbol({40, 40, static_cast<double>(space_weight), 5, 1, 1, 1, 1, 1});
+        string text;
+        for (size_t j = 0; j < size; ++j) {
+            text += alphabet[symbol(generator)];
+        }
+        const auto expected = split_naive(text);
+        ASSERT_EQUAL_HINT(split(text), expected, text);
+        SplitIntoWords(text, words);
+        ASSERT_EQUAL(words.size(), expected.size());
+        for (size_t j = 0; j < words.size(); ++j) {
+            ASSERT_EQUAL(words[j], expected[j].first);
+            ASSERT_EQUAL(IsValidWord(words[j]), expected[j].second);
+        }
+    }
+}
+
+void TestAllocationFreeSearch() {
+    {
+        const size_t before = allocation_count;
+        const auto pointer = make_unique<int>(1);
+        const size_t after = allocation_count;
+        ASSERT_EQUAL(after, before + 1);
+    }
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 1000, 20);
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, 8, 0.2));
+    }
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 3), {static_cast<int>(i % 7)});
+    }
+
+    auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return rating > 2;
+    };
+    vector<Document> found;
+    auto find_all = [&]() {
+        for (const string &query: queries) {
+            search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, 10, found);
+            search_server.FindTopDocuments(execution::seq, query, predicate, MAX_RESULT_DOCUMENT_COUNT, found);
+        }
+    };
+    // Первый проход заполняет пулы потока, второй уже не выделяет память
+    auto count_allocations = [&]() {
+        find_all();
+        const size_t before = allocation_count;
+        find_all();
+        return allocation_count - before;
+    };
+
+    ASSERT_EQUAL(count_allocations(), 0);
+    for (const string &query: queries) {
+        search_server.FindTopDocuments(execution::seq, query, predicate, MAX_RESULT_DOCUMENT_COUNT, found);
+        const auto expected = search_server.FindTopDocuments(query, predicate);
+        AssertSameDocuments(expected, found, 0);
+    }
+
+    // Сжатые блоки декодируются в буфер курсора
+    search_server.CompressPostings();
+    ASSERT_EQUAL(count_allocations(), 0);
+
+    // Попадания в кеш копируются в память found
+    search_server.SetQueryCacheCapacity(1000);
+    ASSERT_EQUAL(count_allocations(), 0);
+    ASSERT(search_server.GetQueryCacheStatistics().hits > 0);
+}
+
+void TestNearDuplicates() {
+    SearchServer search_server("and with"s);
+    // Общие 9 слов из 10 у документов 1 и 2, мера Жаккара 9 / 11
+    search_server.AddDocument(1, "a b c d e f g h i j"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "a b c d e f g h i k"s, DocumentStatus::ACTUAL, {1});
+    // С документом 1 мера Жаккара 5 / 15
+    search_server.AddDocument(3, "a b c d e v w x y z"s, DocumentStatus::ACTUAL, {1});
+    // Совпадает с документом 3 с точностью до порядка и стоп-слов
+    search_server.AddDocument(4, "z y x w v and e d c b a"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(5, "and with"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(6, "with"s, DocumentStatus::ACTUAL, {1});
+
+    ASSERT(FindDuplicates(search_server) == vector<int>({4, 6}));
+    DuplicateSearchOptions options;
+    options.jaccard_threshold = 0.8;
+    ASSERT(FindDuplicates(search_server, options) == vector<int>({2, 4, 6}));
+    options.jaccard_threshold = 0.3;
+    options.minhash_count = 256;
+    options.band_count = 128;
+    ASSERT(FindDuplicates(search_server, options) == vector<int>({2, 3, 4, 6}));
+
+    options.band_count = 3;
+    try {
+        [[maybe_unused]] const auto ids = FindDuplicates(search_server, options);
+        ASSERT_HINT(false, "band count must divide MinHash count"s);
+    } catch (const invalid_argument &) {
+    }
+    options.band_count = 32;
+    options.jaccard_threshold = 0.0;
+    try {
+        [[maybe_unused]] const auto ids = FindDuplicates(search_server, options);
+        ASSERT_HINT(false, "threshold must be positive"s);
+    } catch (const invalid_argument &) {
+    }
+    options.jaccard_threshold = 0.8;
+    options.minhash_count = 0;
+    try {
+        [[maybe_unused]] const auto ids = FindDuplicates(search_server, options);
+        ASSERT_HINT(false, "MinHash count must be positive"s);
+    } catch (const invalid_argument &) {
+    }
+    options.minhash_count = 256;
+
+    options.jaccard_threshold = 0.8;
+    ASSERT(RemoveDuplicates(search_server, options, false) == vector<int>({2, 4, 6}));
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+
+    // На большом корпусе почти дубликаты находятся так же, как при попарном сравнении
+    SearchServer big_server(""s);
+    mt19937 generator(7);
+    vector<string> texts;
+    for (int id = 0; id < 300; ++id) {
+        string text;
+        if (id % 3 == 2) {
+            // Копия предыдущего документа с одним замененным словом из 20
+            text = texts.back().substr(0, texts.back().rfind(' ')) + " q"s + to_string(id);
+        } else {
+            for (int word = 0; word < 20; ++word) {
+                text += "w"s + to_string(generator() % 1000) + " "s;
+            }
+            text.pop_back();
+        }
+        texts.push_back(text);
+        big_server.AddDocument(id, texts.back(), DocumentStatus::ACTUAL, {1});
+    }
+    options.jaccard_threshold = 0.8;
+    const vector<int> near_duplicates = FindDuplicates(big_server, options);
+    ASSERT_EQUAL(near_duplicates.size(), 100u);
+    for (const int id: near_duplicates) {
+        ASSERT_EQUAL(id % 3, 2);
+    }
+}
+
+void TestDocumentSlots() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "black cat"s, DocumentStatus::BANNED, {2});
+    search_server.AddDocument(3, "cat and dog"s, DocumentStatus::ACTUAL, {3});
+    search_server.RemoveDocument(1);
+    search_server.RemoveDocument(2);
+    // Новые документы занимают освободившиеся слоты и не наследуют их статус и рейтинг
+    search_server.AddDocument(10, "grey cat"s, DocumentStatus::IRRELEVANT, {10});
+    search_server.AddDocuments({{11, "red cat"s, DocumentStatus::ACTUAL, {11}}});
+
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    ASSERT(vector<int>(search_server.begin(), search_server.end()) == vector<int>({3, 10, 11}));
+    const auto actual = search_server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(actual.size(), 2u);
+    ASSERT_EQUAL(actual[0].id, 11);
+    ASSERT_EQUAL(actual[0].rating, 11);
+    ASSERT_EQUAL(actual[1].id, 3);
+    ASSERT_EQUAL(actual[1].rating, 3);
+    const auto irrelevant = search_server.FindTopDocuments("cat"s, DocumentStatus::IRRELEVANT);
+    ASSERT_EQUAL(irrelevant.size(), 1u);
+    ASSERT_EQUAL(irrelevant[0].id, 10);
+    ASSERT_EQUAL(irrelevant[0].rating, 10);
+    ASSERT(search_server.FindTopDocuments("cat"s, DocumentStatus::BANNED).empty());
+    ASSERT(std::get<1>(search_server.MatchDocument("cat"s, 10)) == DocumentStatus::IRRELEVANT);
+
+    const auto frequencies = search_server.GetWordFrequencies(10);
+    ASSERT_EQUAL(frequencies.size(), 2u);
+    ASSERT_EQUAL(frequencies.at("grey"s), 0.5);
+    try {
+        [[maybe_unused]] const auto removed = search_server.GetWordFrequencies(1);
+        ASSERT_HINT(false, "removed document must not be found"s);
+    } catch (const out_of_range &) {
+    }
+    try {
+        [[maybe_unused]] const auto removed = search_server.MatchDocument("cat"s, 2);
+        ASSERT_HINT(false, "removed document must not be matched"s);
+    } catch (const out_of_range &) {
+    }
+}
+
+void TestDocumentFilters() {
+    {
+        DocumentBitmap bitmap;
+        bitmap.Set(3);
+        bitmap.Set(64);
+        bitmap.Set(200);
+        ASSERT(bitmap.Test(3) && bitmap.Test(64) && bitmap.Test(200));
+        ASSERT(!bitmap.Test(4) && !bitmap.Test(1000));
+        bitmap.Reset(64);
+        bitmap.Reset(5000);
+        ASSERT_EQUAL(bitmap.Count(), 2u);
+        ASSERT(!bitmap.Test(64));
+    }
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 3000, 20);
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 4), {static_cast<int>(i % 11)});
+    }
+    // Освободившиеся слоты занимают документы с другим статусом
+    for (int i = 0; i < 3000; i += 7) {
+        search_server.RemoveDocument(i);
+    }
+    for (int i = 0; i < 3000; i += 7) {
+        search_server.AddDocument(3000 + i, documents[i], static_cast<DocumentStatus>((i + 1) % 4), {i % 13});
+    }
+
+    DocumentFilter rating_filter;
+    rating_filter.min_rating = 3;
+    rating_filter.max_rating = 6;
+    DocumentFilter status_rating_filter = rating_filter;
+    status_rating_filter.status = DocumentStatus::IRRELEVANT;
+    auto in_range = [](int rating) { return 3 <= rating && rating <= 6; };
+
+    auto check = [&](const auto &policy) {
+        for (int i = 0; i < 50; ++i) {
+            const string query = GenerateQuery(generator, dictionary, 5, 0.2);
+            for (const auto status: {DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::REMOVED}) {
+                DocumentFilter filter;
+                filter.status = status;
+                const auto expected = search_server.FindTopDocuments(
+                        policy, query, [status](int id, DocumentStatus document_status, int rating) {
+                            return document_status == status;
+                        }, 10);
+                AssertSameDocuments(expected, search_server.FindTopDocuments(policy, query, filter, 10), 0, query);
+                AssertSameDocuments(expected, search_server.FindTopDocuments(policy, query, status, 10), 0, query);
+            }
+            const auto any = [](int, DocumentStatus, int) { return true; };
+            const auto rating_in_range = [&](int, DocumentStatus, int rating) { return in_range(rating); };
+            const auto irrelevant_rating_in_range = [&](int, DocumentStatus status, int rating) {
+                return status == DocumentStatus::IRRELEVANT && in_range(rating);
+            };
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query, DocumentFilter(), 10),
+                                search_server.FindTopDocuments(policy, query, any, 10), 0, query);
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query, rating_filter, 10),
+                                search_server.FindTopDocuments(policy, query, rating_in_range, 10), 0, query);
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query, status_rating_filter, 10),
+                                search_server.FindTopDocuments(policy, query, irrelevant_rating_in_range, 10), 0,
+                                query);
+        }
+    };
+    check(execution::seq);
+    check(execution::par);
+    check(query_evaluation::max_score);
+
+    // Разные фильтры не должны делить записи кеша
+    search_server.SetQueryCacheCapacity(100);
+    const string query = dictionary[1] + " "s + dictionary[2];
+    const auto all = search_server.FindTopDocuments(query, DocumentFilter(), 1000);
+    const auto filtered = search_server.FindTopDocuments(query, rating_filter, 1000);
+    ASSERT(!filtered.empty() && filtered.size() < all.size());
+    AssertSameDocuments(all, search_server.FindTopDocuments(query, DocumentFilter(), 1000), 0);
+    for (const Document &document: search_server.FindTopDocuments(query, rating_filter, 1000)) {
+        ASSERT(in_range(document.rating));
+    }
+    ASSERT_EQUAL(search_server.GetQueryCacheStatistics().hits, 2u);
+
+    // Ключ пользователя, совпадающий по байтам с ключом фильтра, не получает выдачу фильтра
+    const int filter_key[] = {false, static_cast<int>(DocumentStatus::ACTUAL), rating_filter.min_rating,
+                              rating_filter.max_rating};
+    const auto any = [](int, DocumentStatus, int) { return true; };
+    AssertSameDocuments(all, search_server.FindTopDocumentsCached(
+            execution::seq, query, string_view(reinterpret_cast<const char *>(filter_key), sizeof(filter_key)), any,
+            1000), 0);
+}
+
+void TestMinusWordExclusion() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 200, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 2000, 15);
+    SearchServer search_server(""s);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 5)});
+    }
+
+    auto check = [&](const string &query, const vector<string> &minus_words) {
+        const auto status = DocumentStatus::ACTUAL;
+        const auto expected = search_server.FindTopDocuments(query_evaluation::max_score, query, status, 2000);
+        for (const auto &found: {search_server.FindTopDocuments(query, status, 2000),
+                                 search_server.FindTopDocuments(execution::par, query, status, 2000)}) {
+            AssertSameDocuments(expected, found, EPSILON, query);
+        }
+        for (const Document &document: expected) {
+            const auto frequencies = search_server.GetWordFrequencies(document.id);
+            for (const string &word: minus_words) {
+                ASSERT_HINT(frequencies.count(word) == 0, query);
+            }
+        }
+    };
+    for (int compressed = 0; compressed < 2; ++compressed) {
+        for (int i = 0; i < 100; ++i) {
+            string query = GenerateQuery(generator, dictionary, 4);
+            vector<string> minus_words;
+            // До пяти минус-слов. Все слова словаря частые, поэтому исключение идет по картам из кеша
+            for (int j = 0; j < i % 6; ++j) {
+                minus_words.push_back(dictionary[generator() % dictionary.size()]);
+                query += " -"s + minus_words.back();
+            }
+            check(query, minus_words);
+        }
+        search_server.CompressPostings();
+    }
+    // Минус-слово из каждого документа исключает все
+    search_server.AddDocument(5000, "spam"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.FindTopDocuments("spam -spam"s).size(), 0);
+
+    // Карта из кеша не переживает изменения индекса, в том числе повторное использование слота
+    SearchServer spam_server(""s);
+    for (int id = 0; id < 400; ++id) {
+        spam_server.AddDocument(id, id < 200 ? "cat spam"s : "cat dog"s, DocumentStatus::ACTUAL, {1});
+    }
+    const auto count_found = [&spam_server](const string &query) {
+        return spam_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000).size();
+    };
+    ASSERT_EQUAL(count_found("cat -spam"s), 200);
+    spam_server.RemoveDocument(0);
+    spam_server.AddDocument(1000, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(count_found("cat -spam"s), 201);
+    spam_server.AddDocument(1001, "cat spam"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(count_found("cat -spam"s), 201);
+
+    // У редкого плюс-слова вхождений мало, и частое минус-слово ищется галопом без сборки карты
+    for (int id = 2000; id < 22000; ++id) {
+        spam_server.AddDocument(id, "spam"s, DocumentStatus::ACTUAL, {1});
+    }
+    spam_server.AddDocument(50000, "owl spam"s, DocumentStatus::ACTUAL, {1});
+    spam_server.AddDocument(50001, "owl"s, DocumentStatus::ACTUAL, {1});
+    for (int compressed = 0; compressed < 2; ++compressed) {
+        const auto found = spam_server.FindTopDocuments("owl -spam"s);
+        ASSERT_EQUAL(found.size(), 1);
+        ASSERT_EQUAL(found[0].id, 50001);
+        spam_server.CompressPostings();
+    }
+}
+
+void TestDocumentRangeParallelism() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 20, 5);
+    const auto documents = GenerateQueries(generator, dictionary, 20000, 5);
+    SearchServer search_server(""s);
+    // Id с пропусками: отрезки делят диапазон id, а не документы
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i * 3 + i % 7), documents[i], DocumentStatus::ACTUAL,
+                                  {static_cast<int>(i % 11)});
+    }
+
+    // Релевантности, различающиеся меньше EPSILON, считаются равными, и порядок таких документов
+    // зависит от порядка отбора. Поэтому сравниваются релевантности по местам и релевантность каждого id.
+    auto check = [&search_server](const string &query) {
+        map<int, double> expected_relevance;
+        for (const Document &document: search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL,
+                                                                      100000)) {
+            expected_relevance[document.id] = document.relevance;
+        }
+        for (const size_t top_k: {size_t(1), size_t(10), size_t(100000)}) {
+            const auto expected = search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, top_k);
+            const auto found = search_server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, top_k);
+            ASSERT_EQUAL_HINT(found.size(), expected.size(), query);
+            for (size_t i = 0; i < found.size(); ++i) {
+                ASSERT_HINT(abs(found[i].relevance - expected[i].relevance) < 10 * EPSILON, query);
+                ASSERT_HINT(expected_relevance.count(found[i].id) > 0, query);
+                ASSERT_EQUAL_HINT(found[i].relevance, expected_relevance.at(found[i].id), query);
+            }
+        }
+    };
+    for (int compressed = 0; compressed < 2; ++compressed) {
+        // Одно слово - один отрезок, все слова словаря - несколько
+        check(dictionary[0]);
+        check(dictionary[1] + " "s + dictionary[2] + " -"s + dictionary[3]);
+        string all_words;
+        for (const string &word: dictionary) {
+            all_words += word + " "s;
+        }
+        check(all_words);
+        check(all_words + "-"s + dictionary[4]);
+        search_server.CompressPostings();
+    }
+    // Документ на краю диапазона id попадает в последний отрезок
+    search_server.AddDocument(numeric_limits<int>::max(), dictionary[0], DocumentStatus::ACTUAL, {100});
+    string all_words;
+    for (const string &word: dictionary) {
+        all_words += word + " "s;
+    }
+    check(all_words);
+    const auto found = search_server.FindTopDocuments(execution::par, dictionary[0], DocumentStatus::ACTUAL, 100000);
+    ASSERT(any_of(found.begin(), found.end(), [](const Document &document) {
+        return document.id == numeric_limits<int>::max();
+    }));
+}
+
+void TestTaskScheduler() {
+    TaskScheduler task_scheduler({4, false});
+    ASSERT_EQUAL(task_scheduler.GetThreadCount(), 4);
+
+    // Каждый индекс - ровно один раз
+    {
+        vector<int> visits(100000);
+        task_scheduler.ParallelFor(visits.size(), [&visits](size_t i) {
+            ++visits[i];
+        });
+        ASSERT(all_of(visits.begin(), visits.end(), [](int count) { return count == 1; }));
+    }
+
+    // Вложенный ParallelFor выполняется теми же потоками, новых не появляется
+    {
+        mutex threads_mutex;
+        set<thread::id> threads;
+        vector<vector<int>> visits(16, vector<int>(1000));
+        task_scheduler.ParallelFor(visits.size(), [&](size_t i) {
+            task_scheduler.ParallelFor(visits[i].size(), [&](size_t j) {
+                ++visits[i][j];
+                lock_guard guard(threads_mutex);
+                threads.insert(this_thread::get_id());
+            });
+        });
+        for (const auto &inner_visits: visits) {
+            ASSERT(all_of(inner_visits.begin(), inner_visits.end(), [](int count) { return count == 1; }));
+        }
+        ASSERT(threads.size() <= task_scheduler.GetThreadCount());
+    }
+
+    // Исключение пробрасывается после завершения остальных частей, первая и последняя части - не та, что бросила
+    {
+        vector<int> visits(1000);
+        try {
+            task_scheduler.ParallelFor(visits.size(), [&visits](size_t i) {
+                if (i == 500) {
+                    throw invalid_argument("500"s);
+                }
+                ++visits[i];
+            });
+            ASSERT_HINT(false, "exception expected"s);
+        } catch (const invalid_argument &error) {
+            ASSERT_EQUAL(string(error.what()), "500"s);
+        }
+        ASSERT_EQUAL(visits.front(), 1);
+        ASSERT_EQUAL(visits.back(), 1);
+        ASSERT_EQUAL(visits[500], 0);
+    }
+
+    // Один поток - все в вызывающем потоке
+    {
+        TaskScheduler single_thread({1, false});
+        const auto caller = this_thread::get_id();
+        bool same_thread = true;
+        single_thread.ParallelFor(100, [&](size_t) {
+            same_thread = same_thread && this_thread::get_id() == caller;
+        });
+        ASSERT(same_thread);
+    }
+
+    // Закрепление за ядрами
+    {
+        TaskScheduler pinned({2, true});
+        atomic<int> sum = 0;
+        pinned.ParallelFor(100, [&sum](size_t i) {
+            sum += static_cast<int>(i);
+        });
+        ASSERT_EQUAL(sum.load(), 4950);
+    }
+
+    // Параллельные методы сервера на своем планировщике дают то же, что последовательные
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 3000, 12);
+    vector<DocumentToAdd> to_add;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        to_add.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 9)}});
+    }
+    SearchServer seq_server(dictionary[0]);
+    SearchServer par_server(dictionary[0]);
+    par_server.SetTaskScheduler(task_scheduler);
+    seq_server.AddDocuments(execution::seq, to_add);
+    par_server.AddDocuments(execution::par, to_add);
+    vector<int> removed_ids;
+    for (int id = 0; id < 3000; id += 7) {
+        removed_ids.push_back(id);
+    }
+    seq_server.RemoveDocuments(execution::seq, removed_ids);
+    par_server.RemoveDocuments(execution::par, removed_ids);
+    seq_server.RemoveDocument(execution::seq, 1);
+    par_server.RemoveDocument(execution::par, 1);
+    ASSERT_EQUAL(par_server.GetDocumentCount(), seq_server.GetDocumentCount());
+
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, 5, 0.2));
+    }
+    const auto documents_lists = ProcessQueries(par_server, queries);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = seq_server.FindTopDocuments(queries[i]);
+        for (const auto &found: {documents_lists[i], par_server.FindTopDocuments(execution::par, queries[i])}) {
+            ASSERT_EQUAL_HINT(found.size(), expected.size(), queries[i]);
+            for (size_t j = 0; j < found.size(); ++j) {
+                ASSERT_EQUAL_HINT(found[j].id, expected[j].id, queries[i]);
+            }
+        }
+        const int document_id = 7 * static_cast<int>(i) + 3;
+        ASSERT(par_server.MatchDocument(execution::par, queries[i], document_id) ==
+               seq_server.MatchDocument(queries[i], document_id));
+    }
+}
+
 void TestSearchServer() {
     CODE_DURATION("TOTAL TEST");
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
@@ -552,6 +2417,31 @@ void TestSearchServer() {
     RUN_TEST(TestDifferentVersionsMatchDocument);
     RUN_TEST(TestDifferentVersionsFindTopDocuments);
     RUN_TEST(StressTestDifferentVersionsFindTopDocuments);
+    RUN_TEST(TestPostingListOrder);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestFindTopDocumentsCount);
+    RUN_TEST(TestScoreAccumulator);
+    RUN_TEST(TestConcurrentMap);
+    RUN_TEST(TestMaxScoreEvaluation);
+    RUN_TEST(TestCompressedPostings);
+    RUN_TEST(TestIndexSnapshot);
+    RUN_TEST(TestDurableSearchServer);
+    RUN_TEST(TestRemoveDocuments);
+    RUN_TEST(TestTextArena);
+    RUN_TEST(TestAddDocuments);
+    RUN_TEST(TestVersionedSearchServer);
+    RUN_TEST(TestSegmentedSearchServer);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestImpactScores);
+    RUN_TEST(TestWordTokenizer);
+    RUN_TEST(TestAllocationFreeSearch);
+    RUN_TEST(TestNearDuplicates);
+    RUN_TEST(TestDocumentSlots);
+    RUN_TEST(TestDocumentFilters);
+    RUN_TEST(TestMinusWordExclusion);
+    RUN_TEST(TestDocumentRangeParallelism);
+    RUN_TEST(TestTaskScheduler);
 }
 
 // --------- Окончание модульных тестов поисковой системы -----------
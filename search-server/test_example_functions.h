@@ -5,12 +5,28 @@
 #ifndef SEARCH_SERVER_TEST_EXAMPLE_FUNCTIONS_H
 #define SEARCH_SERVER_TEST_EXAMPLE_FUNCTIONS_H
 
+#include "concurrent_map.h"
+#include "durable_search_server.h"
+#include "file_sync.h"
+#include "index_snapshot.h"
 #include "log_duration.h"
+#include "output_functions.h"
 #include "paginator.h"
 #include "request_queue.h"
 #include "search_server.h"
+#include "segmented_search_server.h"
+#include "sharded_search_server.h"
+#include "stream_vbyte.h"
+#include "task_scheduler.h"
+#include "text_arena.h"
+#include "versioned_search_server.h"
 #include "remove_duplicates.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <random>
 
 
@@ -45,6 +61,11 @@ AssertImpl(bool value, const std::string &expr_str, const std::string &file, con
 
 #define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
 
+// Выдачи совпадают: те же документы с теми же рейтингами в том же порядке,
+// релевантность - с точностью до tolerance (0 - точное совпадение)
+void AssertSameDocuments(const std::vector<Document> &expected, const std::vector<Document> &actual,
+                         double tolerance = EPSILON, const std::string &hint = {});
+
 template<typename T, typename U>
 void RunTestImpl(T &test, U &func) {
     CODE_DURATION(func);
@@ -95,6 +116,56 @@ void TestDifferentVersionsMatchDocument();
 
 void TestDifferentVersionsFindTopDocuments();
 
+void TestPostingListOrder();
+
+void TestTermDictionary();
+
+void TestFindTopDocumentsCount();
+
+void TestScoreAccumulator();
+
+void TestConcurrentMap();
+
+void TestMaxScoreEvaluation();
+
+void TestCompressedPostings();
+
+void TestIndexSnapshot();
+
+void TestDurableSearchServer();
+
+void TestRemoveDocuments();
+
+void TestTextArena();
+
+void TestAddDocuments();
+
+void TestVersionedSearchServer();
+
+void TestSegmentedSearchServer();
+
+void TestShardedSearchServer();
+
+void TestQueryCache();
+
+void TestImpactScores();
+
+void TestWordTokenizer();
+
+void TestAllocationFreeSearch();
+
+void TestNearDuplicates();
+
+void TestDocumentSlots();
+
+void TestDocumentFilters();
+
+void TestMinusWordExclusion();
+
+void TestDocumentRangeParallelism();
+
+void TestTaskScheduler();
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer();
 
@@ -0,0 +1,141 @@
+//
+// -------- Хранилище текстов документов ----------
+//
+
+#include "text_arena.h"
+
+#include <cstring>
+
+using namespace std;
+
+TextId TextArena::Store(string_view text) {
+    const Location location = Place(text);
+    live_bytes_ += location.size;
+    if (!free_text_ids_.empty()) {
+        const TextId text_id = free_text_ids_.back();
+        free_text_ids_.pop_back();
+        texts_[text_id] = location;
+        return text_id;
+    }
+    texts_.push_back(location);
+    return static_cast<TextId>(texts_.size() - 1);
+}
+
+string_view TextArena::Get(TextId text_id) const {
+    const Location &location = texts_[text_id];
+    if (location.size == 0) {
+        return {};
+    }
+    return {chunks_[location.chunk].data.data() + location.offset, location.size};
+}
+
+void TextArena::Release(TextId text_id) {
+    const Location location = texts_[text_id];
+    free_text_ids_.push_back(text_id);
+    if (location.size == 0) {
+        return;
+    }
+    live_bytes_ -= location.size;
+    Chunk &chunk = chunks_[location.chunk];
+    chunk.live_bytes -= location.size;
+    if (chunk.live_bytes == 0) {
+        ReleaseChunk(location.chunk);
+    }
+    // Запас в блок нужен, чтобы хранилище с малым числом текстов не переносило их при каждом удалении
+    if (used_bytes_ > 2 * live_bytes_ + TEXT_ARENA_CHUNK_SIZE) {
+        Compact();
+    }
+}
+
+void TextArena::Compact() {
+    vector<bool> is_sparse(chunks_.size(), false);
+    bool has_sparse = false;
+    for (uint32_t chunk = 0; chunk < chunks_.size(); ++chunk) {
+        if (!chunks_[chunk].data.empty() && 2 * chunks_[chunk].live_bytes < chunks_[chunk].data.size()) {
+            is_sparse[chunk] = true;
+            has_sparse = true;
+        }
+    }
+    if (!has_sparse) {
+        return;
+    }
+    // В разреженный блок ничего не дописывается, новые тексты пойдут в новые блоки
+    if (current_chunk_ != NO_CHUNK && is_sparse[current_chunk_]) {
+        current_chunk_ = NO_CHUNK;
+    }
+
+    // Освобожденные TextId пропускаются: их старые места могут лежать в уже переиспользованных блоках
+    vector<bool> is_free(texts_.size(), false);
+    for (const TextId text_id: free_text_ids_) {
+        is_free[text_id] = true;
+    }
+    for (TextId text_id = 0; text_id < texts_.size(); ++text_id) {
+        Location &location = texts_[text_id];
+        if (is_free[text_id] || location.size == 0 || !is_sparse[location.chunk]) {
+            continue;
+        }
+        // Блоки могут добавиться, но данные старого блока при этом не перемещаются
+        const Location new_location = Place(Get(text_id));
+        chunks_[location.chunk].live_bytes -= location.size;
+        location = new_location;
+    }
+    for (uint32_t chunk = 0; chunk < is_sparse.size(); ++chunk) {
+        if (is_sparse[chunk]) {
+            ReleaseChunk(chunk);
+        }
+    }
+}
+
+size_t TextArena::GetMemoryUsage() const {
+    size_t memory_usage = chunks_.capacity() * sizeof(Chunk) + free_chunks_.capacity() * sizeof(uint32_t) +
+                          texts_.capacity() * sizeof(Location) + free_text_ids_.capacity() * sizeof(TextId);
+    for (const Chunk &chunk: chunks_) {
+        memory_usage += chunk.data.capacity();
+    }
+    return memory_usage;
+}
+
+TextArena::Location TextArena::Place(string_view text) {
+    if (text.empty()) {
+        return {NO_CHUNK, 0, 0};
+    }
+    uint32_t chunk;
+    if (text.size() > TEXT_ARENA_CHUNK_SIZE) {
+        chunk = AcquireChunk(text.size());
+    } else {
+        if (current_chunk_ == NO_CHUNK || chunks_[current_chunk_].data.size() + text.size() > TEXT_ARENA_CHUNK_SIZE) {
+            current_chunk_ = AcquireChunk(TEXT_ARENA_CHUNK_SIZE);
+        }
+        chunk = current_chunk_;
+    }
+    auto &data = chunks_[chunk].data;
+    // Копия хранилища получает блоки без запаса, поэтому вставка может перевыделить память - это безопасно,
+    // так как тексты адресуются номером блока и смещением
+    const auto offset = static_cast<uint32_t>(data.size());
+    data.insert(data.end(), text.begin(), text.end());
+    chunks_[chunk].live_bytes += text.size();
+    used_bytes_ += text.size();
+    return {chunk, offset, static_cast<uint32_t>(text.size())};
+}
+
+uint32_t TextArena::AcquireChunk(size_t capacity) {
+    uint32_t chunk;
+    if (!free_chunks_.empty()) {
+        chunk = free_chunks_.back();
+        free_chunks_.pop_back();
+    } else {
+        chunk = static_cast<uint32_t>(chunks_.size());
+        chunks_.emplace_back();
+    }
+    chunks_[chunk].data.reserve(capacity);
+    return chunk;
+}
+
+void TextArena::ReleaseChunk(uint32_t chunk) {
+    used_bytes_ -= chunks_[chunk].data.size();
+    chunks_[chunk] = Chunk();
+    free_chunks_.push_back(chunk);
+    if (chunk == current_chunk_) {
+        current_chunk_ = NO_CHUNK;
+    }
+}
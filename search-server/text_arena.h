@@ -0,0 +1,74 @@
+//
+// -------- Хранилище текстов документов ----------
+//
+
+#ifndef SEARCH_SERVER_TEXT_ARENA_H
+#define SEARCH_SERVER_TEXT_ARENA_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using TextId = uint32_t;
+
+const size_t TEXT_ARENA_CHUNK_SIZE = 64 * 1024;
+
+// Тексты лежат подряд в блоках по TEXT_ARENA_CHUNK_SIZE байт (текст длиннее получает отдельный блок).
+// Для каждого блока считается число байт живых текстов: блок без живых текстов освобождается сразу,
+// а когда живых байт становится меньше половины занятых, тексты из разреженных блоков переносятся
+// в новые блоки. Поэтому память пропорциональна живым текстам, а стоимость переноса
+// раскладывается на освобожденные байты.
+//
+// Текст доступен по TextId, который при переносе не меняется. Возвращаемый Get string_view
+// действителен до следующего изменения хранилища.
+class TextArena {
+public:
+    TextId Store(std::string_view text);
+
+    [[nodiscard]] std::string_view Get(TextId text_id) const;
+
+    void Release(TextId text_id);
+
+    // Переносит живые тексты из блоков, заполненных живыми текстами меньше чем наполовину
+    void Compact();
+
+    // Байт в живых текстах
+    [[nodiscard]] size_t GetLiveBytes() const { return live_bytes_; }
+
+    // Байт, занятых блоками, включая тексты, удаленные после последнего переноса
+    [[nodiscard]] size_t GetUsedBytes() const { return used_bytes_; }
+
+    [[nodiscard]] size_t GetMemoryUsage() const;
+
+private:
+    static constexpr uint32_t NO_CHUNK = UINT32_MAX;
+
+    struct Chunk {
+        std::vector<char> data;
+        size_t live_bytes = 0;
+    };
+
+    struct Location {
+        uint32_t chunk;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    std::vector<Chunk> chunks_;
+    std::vector<uint32_t> free_chunks_;
+    // Блок, в который дописываются новые тексты
+    uint32_t current_chunk_ = NO_CHUNK;
+    // Индекс в векторе - TextId
+    std::vector<Location> texts_;
+    std::vector<TextId> free_text_ids_;
+    size_t live_bytes_ = 0;
+    size_t used_bytes_ = 0;
+
+    [[nodiscard]] Location Place(std::string_view text);
+
+    [[nodiscard]] uint32_t AcquireChunk(size_t capacity);
+
+    void ReleaseChunk(uint32_t chunk);
+};
+
+#endif //SEARCH_SERVER_TEXT_ARENA_H
@@ -0,0 +1,58 @@
+//
+// -------- Отбор лучших документов ----------
+//
+
+#include "top_documents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+bool IsMoreRelevant(const Document &lhs, const Document &rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        if (lhs.rating == rhs.rating) {
+            return lhs.id < rhs.id;
+        }
+        return lhs.rating > rhs.rating;
+    } else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+// top_k задает вызывающий, и он может быть намного больше числа найденных документов.
+// Заранее резервируется не больше MAX_RESERVED_DOCUMENTS, дальше куча растет по мере добавления.
+static const size_t MAX_RESERVED_DOCUMENTS = 1024;
+
+TopDocuments::TopDocuments(size_t top_k) : top_k_(top_k) {
+    heap_.reserve(min(top_k_, MAX_RESERVED_DOCUMENTS));
+}
+
+TopDocuments::TopDocuments(size_t top_k, vector<Document> &&buffer) : top_k_(top_k), heap_(move(buffer)) {
+    heap_.clear();
+    heap_.reserve(min(top_k_, MAX_RESERVED_DOCUMENTS));
+}
+
+void TopDocuments::Add(const Document &document) {
+    if (heap_.size() < top_k_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    } else if (top_k_ > 0 && IsMoreRelevant(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+double TopDocuments::GetThreshold() const {
+    if (heap_.size() < top_k_) {
+        return -numeric_limits<double>::infinity();
+    }
+    return heap_.empty() ? numeric_limits<double>::infinity() : heap_.front().relevance;
+}
+
+vector<Document> TopDocuments::Build() {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    return move(heap_);
+}
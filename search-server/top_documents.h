@@ -0,0 +1,45 @@
+//
+// -------- Отбор лучших документов ----------
+//
+
+#ifndef SEARCH_SERVER_TOP_DOCUMENTS_H
+#define SEARCH_SERVER_TOP_DOCUMENTS_H
+
+#include <vector>
+#include "document.h"
+
+const double EPSILON = 1e-6;
+
+// Документ lhs выше в выдаче: релевантность больше, при равной релевантности - больше рейтинг,
+// а при равном рейтинге - меньше id, чтобы выдача не зависела от порядка обхода документов
+bool IsMoreRelevant(const Document &lhs, const Document &rhs);
+
+// Хранит не более top_k лучших документов в куче, на вершине которой худший из отобранных.
+// Добавление документа стоит O(log top_k), поэтому полная сортировка всех найденных не нужна.
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t top_k);
+
+    // Отбирает документы в памяти buffer: Build вернет тот же вектор, и выделений не будет,
+    // если емкости buffer хватает на отобранные документы
+    TopDocuments(size_t top_k, std::vector<Document> &&buffer);
+
+    void Add(const Document &document);
+
+    // Отобранные документы от лучшего к худшему
+    std::vector<Document> Build();
+
+    // Релевантность, которую должен превзойти документ, чтобы попасть в отобранные.
+    // Пока отобрано меньше top_k документов, подходит любой.
+    [[nodiscard]] double GetThreshold() const;
+
+    [[nodiscard]] size_t size() const { return heap_.size(); }
+
+    [[nodiscard]] size_t GetTopK() const { return top_k_; }
+
+private:
+    size_t top_k_;
+    std::vector<Document> heap_;
+};
+
+#endif //SEARCH_SERVER_TOP_DOCUMENTS_H
@@ -0,0 +1,80 @@
+//
+// -------- Поисковой сервер с версиями ----------
+//
+
+#include "versioned_search_server.h"
+
+#include <atomic>
+
+using namespace std;
+
+VersionedSearchServer::VersionedSearchServer(SearchServer search_server)
+        : published_(make_shared<SearchServer>(move(search_server))) {}
+
+shared_ptr<const SearchServer> VersionedSearchServer::GetVersion() const {
+    return atomic_load(&published_);
+}
+
+void VersionedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                        const vector<int> &ratings) {
+    lock_guard guard(writer_mutex_);
+    // Некорректный документ отклоняется без изменений, поэтому в журнал попадают только примененные
+    GetDraft().AddDocument(document_id, document, status, ratings);
+    draft_changes_.push_back({false, document_id, string(document), status, ratings});
+}
+
+void VersionedSearchServer::AddDocuments(const vector<DocumentToAdd> &documents) {
+    lock_guard guard(writer_mutex_);
+    GetDraft().AddDocuments(execution::par, documents);
+    for (const auto &document: documents) {
+        draft_changes_.push_back({false, document.document_id, string(document.document), document.status,
+                                  document.ratings});
+    }
+}
+
+void VersionedSearchServer::RemoveDocument(int document_id) {
+    lock_guard guard(writer_mutex_);
+    GetDraft().RemoveDocument(document_id);
+    draft_changes_.push_back({true, document_id, {}, {}, {}});
+}
+
+void VersionedSearchServer::Publish() {
+    lock_guard guard(writer_mutex_);
+    if (!draft_) {
+        return;
+    }
+    shared_ptr<const SearchServer> previous = atomic_exchange(&published_, shared_ptr<const SearchServer>(draft_));
+    // Предыдущая версия всегда была создана как изменяемая: в конструкторе или через GetDraft
+    retired_ = const_pointer_cast<SearchServer>(previous);
+    retired_missing_changes_ = move(draft_changes_);
+    draft_changes_.clear();
+    draft_.reset();
+}
+
+SearchServer &VersionedSearchServer::GetDraft() {
+    if (draft_) {
+        return *draft_;
+    }
+    // Новые читатели не могут получить retired_, поэтому единственный владелец - признак того,
+    // что все читатели предыдущей версии закончили
+    if (retired_ && retired_.use_count() == 1) {
+        atomic_thread_fence(memory_order_acquire);
+        for (const Change &change: retired_missing_changes_) {
+            Apply(*retired_, change);
+        }
+        draft_ = move(retired_);
+    } else {
+        draft_ = make_shared<SearchServer>(*published_);
+    }
+    retired_.reset();
+    retired_missing_changes_.clear();
+    return *draft_;
+}
+
+void VersionedSearchServer::Apply(SearchServer &search_server, const Change &change) {
+    if (change.is_removal) {
+        search_server.RemoveDocument(change.document_id);
+    } else {
+        search_server.AddDocument(change.document_id, change.document, change.status, change.ratings);
+    }
+}
@@ -0,0 +1,66 @@
+//
+// -------- Поисковой сервер с версиями ----------
+//
+
+#ifndef SEARCH_SERVER_VERSIONED_SEARCH_SERVER_H
+#define SEARCH_SERVER_VERSIONED_SEARCH_SERVER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "search_server.h"
+
+// Читатели ищут по опубликованной неизменяемой версии индекса, а писатель тем временем готовит
+// следующую (RCU). Изменения не видны читателям до вызова Publish, который заменяет опубликованную
+// версию одной атомарной операцией. Читатель, получивший версию, держит ее shared_ptr:
+// старая версия живет, пока ее не отпустит последний читатель.
+//
+// Версий две. Следующая версия готовится на месте предыдущей, если читателей у той больше нет:
+// к ней применяются изменения, которых в ней не хватает. Иначе опубликованная версия копируется.
+//
+// Методы поиска работают без блокировок. Изменения и Publish можно вызывать из разных потоков,
+// они выполняются по очереди.
+class VersionedSearchServer {
+public:
+    explicit VersionedSearchServer(SearchServer search_server = SearchServer());
+
+    // Опубликованная версия, ее можно передавать в FindTopDocuments, ProcessQueries и т. д.
+    [[nodiscard]] std::shared_ptr<const SearchServer> GetVersion() const;
+
+    void
+    AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+
+    void AddDocuments(const std::vector<DocumentToAdd> &documents);
+
+    void RemoveDocument(int document_id);
+
+    // Делает все изменения видимыми читателям
+    void Publish();
+
+private:
+    struct Change {
+        bool is_removal;
+        int document_id;
+        std::string document;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+
+    std::shared_ptr<const SearchServer> published_;
+    std::mutex writer_mutex_;
+    // Следующая версия, создается при первом изменении после Publish
+    std::shared_ptr<SearchServer> draft_;
+    // Изменения draft_ со времени его создания
+    std::vector<Change> draft_changes_;
+    // Предыдущая опубликованная версия и изменения, которых в ней нет
+    std::shared_ptr<SearchServer> retired_;
+    std::vector<Change> retired_missing_changes_;
+
+    SearchServer &GetDraft();
+
+    static void Apply(SearchServer &search_server, const Change &change);
+};
+
+#endif //SEARCH_SERVER_VERSIONED_SEARCH_SERVER_H
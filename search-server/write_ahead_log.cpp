@@ -0,0 +1,233 @@
+//
+// -------- Журнал изменений ----------
+//
+
+#include "write_ahead_log.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include "file_sync.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Файловые вызовы POSIX и их аналоги из CRT Windows; _commit, как и fsync, сбрасывает данные на диск
+#ifdef _WIN32
+static int OpenForAppend(const string &path) {
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+static long long WriteSome(int fd, const char *data, size_t size) {
+    return _write(fd, data, static_cast<unsigned int>(min<size_t>(size, INT_MAX)));
+}
+
+static int SyncFile(int fd) {
+    return _commit(fd);
+}
+
+static int CloseFile(int fd) {
+    return _close(fd);
+}
+#else
+static int OpenForAppend(const string &path) {
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+static long long WriteSome(int fd, const char *data, size_t size) {
+    return write(fd, data, size);
+}
+
+static int SyncFile(int fd) {
+    return fsync(fd);
+}
+
+static int CloseFile(int fd) {
+    return close(fd);
+}
+#endif
+
+// Длина и контрольная сумма перед содержимым записи
+static const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+static array<uint32_t, 256> MakeCrc32Table() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint32_t ComputeCrc32(string_view data) {
+    static const array<uint32_t, 256> table = MakeCrc32Table();
+    uint32_t crc = 0xFFFFFFFFU;
+    for (const char c: data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+template<typename Number>
+static void PutNumber(string &out, Number value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Читает число из начала in и сдвигает in; если данных не хватает, возвращает false
+template<typename Number>
+static bool GetNumber(string_view &in, Number &value) {
+    if (in.size() < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+static bool ParseRecord(string_view payload, LogRecord &record) {
+    uint8_t operation;
+    if (!GetNumber(payload, operation) || !GetNumber(payload, record.document_id)) {
+        return false;
+    }
+    record.operation = static_cast<LogOperation>(operation);
+    if (record.operation == LogOperation::REMOVE_DOCUMENT) {
+        return payload.empty();
+    }
+    if (record.operation != LogOperation::ADD_DOCUMENT) {
+        return false;
+    }
+    int32_t status;
+    uint32_t rating_count;
+    if (!GetNumber(payload, status) || !GetNumber(payload, rating_count)) {
+        return false;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    record.ratings.resize(rating_count);
+    for (int &rating: record.ratings) {
+        if (!GetNumber(payload, rating)) {
+            return false;
+        }
+    }
+    record.document = payload;
+    return true;
+}
+
+WriteAheadLog::WriteAheadLog(const string &path, WriteAheadLogOptions options)
+        : path_(path), options_(options), fd_(OpenForAppend(path)) {
+    if (fd_ < 0) {
+        throw runtime_error("Can't open write-ahead log " + path + ".");
+    }
+    // Запись каталога о новом журнале тоже должна пережить сбой питания, иначе пропадут и его записи
+    try {
+        SyncParentDirectory(path);
+    } catch (...) {
+        CloseFile(fd_);
+        throw;
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (unsynced_count_ > 0) {
+        SyncFile(fd_);
+    }
+    CloseFile(fd_);
+}
+
+void WriteAheadLog::AppendAddDocument(int document_id, string_view document, DocumentStatus status,
+                                      const vector<int> &ratings) {
+    string payload;
+    PutNumber(payload, static_cast<uint8_t>(LogOperation::ADD_DOCUMENT));
+    PutNumber(payload, static_cast<int32_t>(document_id));
+    PutNumber(payload, static_cast<int32_t>(status));
+    PutNumber(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating: ratings) {
+        PutNumber(payload, static_cast<int32_t>(rating));
+    }
+    payload.append(document);
+    Append(payload);
+}
+
+void WriteAheadLog::AppendRemoveDocument(int document_id) {
+    string payload;
+    PutNumber(payload, static_cast<uint8_t>(LogOperation::REMOVE_DOCUMENT));
+    PutNumber(payload, static_cast<int32_t>(document_id));
+    Append(payload);
+}
+
+void WriteAheadLog::Sync() {
+    if (SyncFile(fd_) != 0) {
+        throw runtime_error("Can't sync write-ahead log " + path_ + ".");
+    }
+    unsynced_count_ = 0;
+}
+
+void WriteAheadLog::Append(const string &payload) {
+    string record;
+    record.reserve(RECORD_HEADER_SIZE + payload.size());
+    PutNumber(record, static_cast<uint32_t>(payload.size()));
+    PutNumber(record, ComputeCrc32(payload));
+    record += payload;
+
+    // Запись собирается целиком и обычно уходит одним вызовом write, повтор нужен только при частичной записи
+    for (size_t written = 0; written < record.size();) {
+        const long long result = WriteSome(fd_, record.data() + written, record.size() - written);
+        if (result < 0) {
+            throw runtime_error("Can't write to write-ahead log " + path_ + ".");
+        }
+        written += static_cast<size_t>(result);
+    }
+    ++unsynced_count_;
+    if (options_.sync_batch_size > 0 && unsynced_count_ >= options_.sync_batch_size) {
+        Sync();
+    }
+}
+
+size_t WriteAheadLog::Replay(const string &path, const function<void(const LogRecord &)> &handler) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        return 0;
+    }
+    const string data{istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+    in.close();
+
+    string_view rest = data;
+    size_t record_count = 0;
+    LogRecord record;
+    while (!rest.empty()) {
+        string_view next = rest;
+        uint32_t size, crc;
+        if (!GetNumber(next, size) || !GetNumber(next, crc) || next.size() < size) {
+            break;
+        }
+        const string_view payload = next.substr(0, size);
+        if (ComputeCrc32(payload) != crc || !ParseRecord(payload, record)) {
+            break;
+        }
+        handler(record);
+        ++record_count;
+        rest = next.substr(size);
+    }
+    if (!rest.empty()) {
+        error_code error;
+        filesystem::resize_file(path, data.size() - rest.size(), error);
+        if (error) {
+            throw runtime_error("Can't cut damaged tail of write-ahead log " + path + ".");
+        }
+    }
+    return record_count;
+}
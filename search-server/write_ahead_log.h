@@ -0,0 +1,71 @@
+//
+// -------- Журнал изменений ----------
+//
+
+#ifndef SEARCH_SERVER_WRITE_AHEAD_LOG_H
+#define SEARCH_SERVER_WRITE_AHEAD_LOG_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+// CRC-32 (IEEE 802.3), которым защищена каждая запись журнала
+uint32_t ComputeCrc32(std::string_view data);
+
+enum class LogOperation : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+};
+
+struct LogRecord {
+    LogOperation operation;
+    int document_id;
+    // Для REMOVE_DOCUMENT остальные поля не заполняются
+    std::string document;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+struct WriteAheadLogOptions {
+    // fsync выполняется после каждых sync_batch_size записей, 0 - только при явном вызове Sync.
+    // Записи, не дошедшие до fsync, могут пропасть при сбое питания, но не при падении процесса.
+    size_t sync_batch_size = 1;
+};
+
+// Журнал, в который изменения только дописываются. Запись: длина и CRC-32 содержимого,
+// затем само содержимое. Числа записываются в порядке байт машины.
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string &path, WriteAheadLogOptions options = {});
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    ~WriteAheadLog();
+
+    void AppendAddDocument(int document_id, std::string_view document, DocumentStatus status,
+                           const std::vector<int> &ratings);
+
+    void AppendRemoveDocument(int document_id);
+
+    void Sync();
+
+    // Передает записи журнала в handler по порядку. Чтение останавливается на первой недописанной
+    // или поврежденной записи: такая запись - след сбоя во время дописывания, и она вместе с остатком
+    // файла отрезается. Возвращает число прочитанных записей.
+    static size_t Replay(const std::string &path, const std::function<void(const LogRecord &)> &handler);
+
+private:
+    std::string path_;
+    WriteAheadLogOptions options_;
+    int fd_;
+    size_t unsynced_count_ = 0;
+
+    void Append(const std::string &payload);
+};
+
+#endif //SEARCH_SERVER_WRITE_AHEAD_LOG_H